@@ -1,10 +1,37 @@
 function [rho]=readvtk(component, nx,ny,nz,dx,filename)
 
 system_size = nx*ny*nz;
-first=10+system_size*component;
-last=first + system_size-1;
 
-M=dlmread(filename,'\t', [first 0 last 0]);
+%% Block index written by the C++ reader (persist_block_index): seek straight to the component
+index_file = [filename '.idx'];
+blocks = [];
+
+if exist(index_file, 'file') == 2
+    blocks = read_block_index(index_file);
+    listing = dir(filename);
+
+    if blocks.size ~= listing.bytes
+        blocks = [];
+    end
+end
+
+if ~isempty(blocks)
+    fid = fopen(filename, 'r');
+    fseek(fid, blocks.begin(component+1), 'bof');
+
+    if strcmp(blocks.encoding, 'BINARY')
+        M = fread(fid, system_size, blocks.type{component+1}, 'ieee-be');
+    else
+        M = fscanf(fid, '%f', system_size);
+    end
+
+    fclose(fid);
+else
+    first=10+system_size*component;
+    last=first + system_size-1;
+
+    M=dlmread(filename,'\t', [first 0 last 0]);
+end
 
 %% Make 1D to 3D
 
@@ -22,4 +49,20 @@ end
 
 
 
-end
\ No newline at end of file
+end
+
+function [blocks]=read_block_index(index_file)
+
+fid = fopen(index_file, 'r');
+fgetl(fid);
+source = sscanf(fgetl(fid), 'source %f %f %f');
+blocks.encoding = sscanf(fgetl(fid), 'encoding %s');
+fgetl(fid);
+C = textscan(fid, '%f %f %s %s');
+fclose(fid);
+
+blocks.size = source(1);
+blocks.begin = C{1};
+blocks.type = C{3};
+
+end
@@ -0,0 +1,123 @@
+#include "async_profile_writer.h"
+
+#include <algorithm>
+
+Async_profile_writer::Async_profile_writer(std::shared_ptr<IProfile_writer> writer_, Lattice_accessor* geometry_, Writable_file file_, size_t queue_length_)
+: IProfile_writer(geometry_, file_), m_writer{writer_}, m_snapshots(std::max<size_t>(queue_length_, 1)), m_writing{false}, m_stopping{false}
+{
+    configuration = m_writer->configuration;
+
+    for (Snapshot& snapshot : m_snapshots)
+        m_free.push_back(&snapshot);
+
+    m_worker = std::thread(&Async_profile_writer::work, this);
+}
+
+Async_profile_writer::~Async_profile_writer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+
+    m_condition.notify_all();
+    m_worker.join();
+
+    if (m_exception)
+        std::cerr << "Asynchronous profile writer failed, some snapshots have not been written.\n";
+}
+
+void Async_profile_writer::prepare_for_data()
+{
+    flush();
+    m_writer->configuration = configuration;
+    m_writer->prepare_for_data();
+}
+
+void Async_profile_writer::rethrow()
+{
+    if (m_exception) {
+        std::exception_ptr exception = m_exception;
+        m_exception = nullptr;
+        std::rethrow_exception(exception);
+    }
+}
+
+void Async_profile_writer::write()
+{
+    Snapshot* snapshot;
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this] { return not m_free.empty() or m_exception; });
+        rethrow();
+
+        snapshot = m_free.front();
+        m_free.pop_front();
+    }
+
+    //Copy outside the lock, the background thread keeps writing meanwhile
+    snapshot->profiles.resize(m_profiles.size());
+    snapshot->bindings.clear();
+
+    size_t i = 0;
+    for (auto& profile : m_profiles) {
+        std::vector<double>& copy = snapshot->profiles[i++];
+        copy.resize(m_geometry->system_size);
+        profile.second->copy(0, copy.size(), 1, copy.data());
+        snapshot->bindings[profile.first] = std::make_shared<Output_ptr<double>>(copy.data());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.push_back(snapshot);
+    }
+
+    m_condition.notify_all();
+}
+
+void Async_profile_writer::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this] { return (m_pending.empty() and not m_writing) or m_exception; });
+    rethrow();
+}
+
+void Async_profile_writer::work()
+{
+    for (;;)
+    {
+        Snapshot* snapshot;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stopping or not m_pending.empty(); });
+
+            if (m_pending.empty())
+                return;
+
+            snapshot = m_pending.front();
+            m_pending.pop_front();
+            m_writing = true;
+        }
+
+        try
+        {
+            m_writer->bind_data(snapshot->bindings);
+            m_writer->write();
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_exception = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_free.push_back(snapshot);
+            m_writing = false;
+        }
+
+        m_condition.notify_all();
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef ASYNC_PROFILE_WRITER_H
+#define ASYNC_PROFILE_WRITER_H
+
+#include "file_writer.h"
+#include "lattice_accessor.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+/*
+ *  Writes a time series of snapshots in the background, as a decorator around any other profile writer.
+ *
+ *  write() copies the bound profiles into one of queue_length snapshot buffers and returns,
+ *  a background thread hands the snapshot to the wrapped writer. Once all buffers are waiting
+ *  to be written, write() blocks until one is free again (backpressure), so memory stays
+ *  at queue_length copies of the profiles.
+ *
+ *  configuration starts as a copy of the wrapped writer's and is handed to it by prepare_for_data(), so the
+ *  decorator is configured like the writer it wraps. The wrapped writer is only touched by the background thread
+ *  afterwards. Errors of the background thread are rethrown by the next write() or flush().
+ */
+
+class Async_profile_writer : public IProfile_writer {
+    public:
+        Async_profile_writer(std::shared_ptr<IProfile_writer>, Lattice_accessor*, Writable_file, size_t queue_length = DEFAULT_QUEUE_LENGTH);
+        ~Async_profile_writer();
+
+        Async_profile_writer(const Async_profile_writer&) = delete;
+        Async_profile_writer& operator=(const Async_profile_writer&) = delete;
+
+        static constexpr size_t DEFAULT_QUEUE_LENGTH = 2;
+
+        //Waits for pending snapshots, then configures and prepares the wrapped writer.
+        virtual void prepare_for_data() override;
+        virtual void write() override;
+        //Blocks until every snapshot written so far is on disk.
+        void flush();
+
+    private:
+        struct Snapshot {
+            std::vector<std::vector<double>> profiles;
+            std::map< std::string, std::shared_ptr<IOutput_ptr> > bindings;
+        };
+
+        std::shared_ptr<IProfile_writer> m_writer;
+
+        std::vector<Snapshot> m_snapshots;
+        std::deque<Snapshot*> m_free;
+        std::deque<Snapshot*> m_pending;
+        bool m_writing;
+        bool m_stopping;
+        std::exception_ptr m_exception;
+
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        std::thread m_worker;
+
+        void work();
+        void rethrow();
+};
+
+#endif
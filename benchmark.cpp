@@ -0,0 +1,344 @@
+#include "file_reader.h"
+#include "file_writer.h"
+#include "lattice_accessor.h"
+#include "thread_pool.h"
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+using namespace boost::program_options;
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <exception>
+#include <functional>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <cstdio>
+
+using namespace std;
+
+//Best of repeats runs of run in seconds, printed with the rate of items per second and the time per item
+double measure(const string& name, double items, const string& unit, size_t repeats, const function<void()>& run)
+{
+    double best = 0;
+
+    for (size_t i = 0 ; i < repeats ; ++i)
+    {
+        const auto start = chrono::steady_clock::now();
+        run();
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        if (best == 0 or seconds < best)
+            best = seconds;
+    }
+
+    cout << left << setw(44) << name << right << setw(10) << fixed << setprecision(3) << best << " s"
+         << setw(10) << setprecision(1) << items / best / 1e6 << " M" << unit << "/s"
+         << setw(10) << setprecision(2) << best / items * 1e9 << " ns" << endl;
+
+    return best;
+}
+
+Lattice_accessor cube(size_t size)
+{
+    Lattice_accessor lattice;
+    lattice.dimensionality = three_D;
+    lattice.MX = lattice.MY = lattice.MZ = size;
+    lattice.set_jumps();
+
+    return lattice;
+}
+
+//Smooth profiles with a bit of noise, so the text has as many digits as real output
+vector<vector<double>> profiles(const Lattice_accessor& lattice, size_t components)
+{
+    mt19937 generator(1);
+    normal_distribution<double> noise(0, 1e-3);
+    vector<vector<double>> values(components, vector<double>(lattice.system_size));
+
+    for (size_t c = 0 ; c < components ; ++c)
+        lattice.for_each(lattice.plus_bounds(), [&] (size_t x, size_t, size_t, size_t index) {
+            values[c][index] = 0.5 + 0.4 * tanh((double(x) - lattice.MX / 2.0) / (c + 2.0)) + noise(generator);
+        });
+
+    return values;
+}
+
+void write_pro(const string& filename, const Lattice_accessor& geometry, vector<vector<double>>& values)
+{
+    Lattice_accessor lattice = geometry;
+    Writable_file file(filename, Writable_filetype::PRO);
+    auto writer = Profile_writer::Factory::Create(Writable_filetype::PRO, &lattice, file);
+    writer->configuration.boundary_mode = IProfile_writer::Boundary_mode::WITH_BOUNDS;
+
+    map<string, shared_ptr<IOutput_ptr>> outputs;
+
+    for (size_t c = 0 ; c < values.size() ; ++c)
+        outputs["mol:m:phi-" + to_string(c)] = make_shared<Output_ptr<double>>(values[c].data());
+
+    writer->bind_data(outputs);
+    writer->prepare_for_data();
+    writer->write();
+}
+
+/***** PARSE *****/
+//.pro parse throughput: the stream path (getline, tokenize, strtod) against the mapped in place parser
+void parse_benchmark(const variables_map& vm, size_t repeats)
+{
+    string input;
+    bool scratch = false;
+
+    if (vm.count("input-file")) {
+        input = vm["input-file"].as< string >();
+    } else {
+        const Lattice_accessor lattice = cube(vm["size"].as< size_t >());
+        vector<vector<double>> values = profiles(lattice, vm["components"].as< size_t >());
+
+        write_pro("benchmark_parse", lattice, values);
+        input = Writable_file("benchmark_parse", Writable_filetype::PRO).get_filename();
+        scratch = true;
+    }
+
+    ifstream file(input, ios::binary | ios::ate);
+
+    if (!file) {
+        cerr << "Could not open " << input << endl;
+        exit(0);
+    }
+
+    const double bytes = file.tellg();
+    const size_t threads = vm["threads"].as< size_t >();
+
+    cout << input << ": " << fixed << setprecision(1) << bytes / 1e6 << " MB" << endl << endl;
+
+    struct Run {
+        string name;
+        IReader::Read_mode mode;
+        size_t threads;
+    };
+
+    vector<Run> runs {
+        {"stream", IReader::Read_mode::STREAM, 1},
+        {"memory mapped", IReader::Read_mode::MEMORY_MAPPED, 1}
+    };
+
+    if (threads > 1)
+        runs.push_back({"memory mapped, " + to_string(threads) + " threads", IReader::Read_mode::MEMORY_MAPPED, threads});
+
+    //The readers report every file they open
+    streambuf* const cout_buffer = cout.rdbuf();
+    ostringstream quiet;
+
+    for (const Run& run : runs)
+        measure("parse, " + run.name, bytes, "B", repeats, [&] {
+            cout.rdbuf(quiet.rdbuf());
+
+            Reader reader;
+            reader.configuration.read_mode = run.mode;
+            reader.configuration.threads = run.threads;
+            vector<vector<double>> components;
+            reader.open(Readable_file(input, Readable_filetype::PRO)).read_into(components);
+
+            cout.rdbuf(cout_buffer);
+            quiet.str("");
+        });
+
+    if (scratch)
+        remove(input.c_str());
+}
+
+/***** WRITE *****/
+//One component written to a scratch file by the writer of type, which is removed afterwards
+void measure_writer(const string& type, Lattice_accessor& lattice, vector<double>& values, size_t repeats)
+{
+    const Writable_filetype filetype = Profile_writer::output_options[type];
+    Writable_file file("benchmark_write", filetype);
+
+    measure(type, lattice.MX * lattice.MY * lattice.MZ, "voxels", repeats, [&] {
+        auto writer = Profile_writer::Factory::Create(filetype, &lattice, file);
+
+        map<string, shared_ptr<IOutput_ptr>> outputs;
+        outputs["mol:m:phi-0"] = make_shared<Output_ptr<double>>(values.data());
+
+        writer->bind_data(outputs);
+        writer->prepare_for_data();
+        writer->write();
+    });
+
+    remove(file.get_filename().c_str());
+}
+
+//Voxels per second of the writers, against the per voxel Output_ptr::data() strings they used to write
+void write_benchmark(const variables_map& vm, size_t repeats)
+{
+    Lattice_accessor lattice = cube(vm["size"].as< size_t >());
+    vector<vector<double>> values = profiles(lattice, 1);
+    const double voxels = lattice.MX * lattice.MY * lattice.MZ;
+
+    cout << lattice.MX << "^3 lattice, one component" << endl << endl;
+
+    const string stem = "benchmark_write";
+
+    measure("per voxel data() strings", voxels, "voxels", repeats, [&] {
+        Output_ptr<double> output(values[0].data());
+        ofstream file(stem + ".txt");
+
+        lattice.skip_bounds([&] (size_t x, size_t y, size_t z) {
+            file << output.data(lattice.index(x, y, z)) << '\n';
+        });
+    });
+
+    remove((stem + ".txt").c_str());
+
+    for (const string type : {"vtk_structured_points", "pro", "vtk_structured_points_binary", "vti"})
+        measure_writer(type, lattice, values[0], repeats);
+}
+
+/***** TRAVERSE *****/
+//Per voxel cost of the traversals, summing a field over the interior
+void traverse_benchmark(const variables_map& vm, size_t repeats)
+{
+    Lattice_accessor lattice = cube(vm["size"].as< size_t >());
+    const vector<double> field = profiles(lattice, 1)[0];
+    const double voxels = lattice.MX * lattice.MY * lattice.MZ;
+    const Lattice_accessor::Range inside = lattice.inside();
+
+    cout << lattice.MX << "^3 interior" << endl << endl;
+
+    //Keeps the compiler from dropping sums that aren't used
+    volatile double sink = 0;
+
+    measure("skip_bounds, std::function and index()", voxels, "voxels", repeats, [&] {
+        double sum = 0;
+        lattice.skip_bounds([&] (size_t x, size_t y, size_t z) { sum += field[lattice.index(x, y, z)]; });
+        sink = sum;
+    });
+
+    measure("for_each, z-major", voxels, "voxels", repeats, [&] {
+        double sum = 0;
+        lattice.for_each(inside, [&] (size_t, size_t, size_t, size_t index) { sum += field[index]; });
+        sink = sum;
+    });
+
+    measure("for_each_in_memory_order", voxels, "voxels", repeats, [&] {
+        double sum = 0;
+        lattice.for_each_in_memory_order(inside, [&] (size_t, size_t, size_t, size_t index) { sum += field[index]; });
+        sink = sum;
+    });
+
+    measure("nested loop", voxels, "voxels", repeats, [&] {
+        double sum = 0;
+
+        for (size_t x = inside.x_begin ; x < inside.x_end ; ++x)
+            for (size_t y = inside.y_begin ; y < inside.y_end ; ++y) {
+                const double* row = field.data() + x * lattice.jump_x + y * lattice.jump_y;
+
+                for (size_t z = inside.z_begin ; z < inside.z_end ; ++z)
+                    sum += row[z];
+            }
+
+        sink = sum;
+    });
+}
+
+/***** STENCIL *****/
+//7-point stencil over the interior in every traversal order, then the gather of the binary writers, which reads
+//in file order (x fastest) across memory order
+void stencil_benchmark(const variables_map& vm, size_t repeats)
+{
+    Lattice_accessor lattice = cube(vm["size"].as< size_t >());
+    vector<double> field = profiles(lattice, 1)[0];
+    vector<double> result(lattice.system_size);
+    const double voxels = lattice.MX * lattice.MY * lattice.MZ;
+    const Lattice_accessor::Range inside = lattice.inside();
+
+    const double* const in = field.data();
+    double* const out = result.data();
+    const size_t jx = lattice.jump_x, jy = lattice.jump_y, jz = lattice.jump_z;
+
+    const auto stencil = [=] (size_t, size_t, size_t, size_t index) {
+        out[index] = in[index - jx] + in[index + jx] + in[index - jy] + in[index + jy] + in[index - jz] + in[index + jz]
+            - 6 * in[index];
+    };
+
+    cout << lattice.MX << "^3 interior" << endl << endl;
+
+    measure("stencil, skip_bounds with std::function", voxels, "voxels", repeats, [&] {
+        lattice.skip_bounds([&] (size_t x, size_t y, size_t z) { stencil(x, y, z, lattice.index(x, y, z)); });
+    });
+
+    measure("stencil, for_each z-major", voxels, "voxels", repeats, [&] {
+        lattice.for_each(inside, stencil);
+    });
+
+    measure("stencil, for_each_in_memory_order", voxels, "voxels", repeats, [&] {
+        lattice.for_each_in_memory_order(inside, stencil);
+    });
+
+    measure("stencil, for_each_tiled", voxels, "voxels", repeats, [&] {
+        lattice.for_each_tiled(inside, stencil);
+    });
+
+    cout << endl;
+
+    for (const string type : {"vtk_structured_points_binary", "vti"})
+        measure_writer(type, lattice, field, repeats);
+}
+
+int main(int argc , char **argv)
+{
+    options_description desc("\nMicrobenchmarks of the readers, writers and lattice traversals, on generated 3D lattices.\nbenchmark [parse|write|traverse|stencil] [options]\nAllowed arguments");
+
+    desc.add_options()
+        ("help,h", "Print this help text.")
+        ("benchmark,b", value< string >()->default_value("parse"), "Which one to run: parse, write, traverse or stencil.")
+        ("input-file,i", value< string >(), "parse: .pro file to read instead of a generated one.")
+        ("size,n", value< size_t >()->default_value(100), "[int] Voxels along every dimension of the generated lattice, without bounds.")
+        ("components,c", value< size_t >()->default_value(4), "[int] Components of the generated lattice.")
+        ("threads,j", value< size_t >()->default_value(Thread_pool::default_thread_count()), "[int] Threads of the parallel runs.")
+        ("repeats,r", value< size_t >()->default_value(3), "[int] Runs per variant, the best one counts.");
+
+    positional_options_description p;
+    p.add("benchmark", 1);
+
+    variables_map vm;
+    try
+    {
+        store( command_line_parser( argc, argv).options(desc).positional(p).run(), vm );
+        notify(vm);
+
+    } catch (std::exception &e)
+    {
+        cerr << endl << e.what() << endl;
+        cerr << desc << endl;
+    }
+
+    if (vm.count("help")) {
+        cerr << desc << endl;
+        exit(0);
+    }
+
+    const map<string, function<void(const variables_map&, size_t)>> benchmarks {
+        {"parse", parse_benchmark},
+        {"write", write_benchmark},
+        {"traverse", traverse_benchmark},
+        {"stencil", stencil_benchmark}
+    };
+
+    const string name = vm["benchmark"].as< string >();
+
+    if (benchmarks.count(name) == 0) {
+        cerr << "Unknown benchmark: " << name << endl;
+        cerr << desc << endl;
+        exit(0);
+    }
+
+    benchmarks.at(name)(vm, max<size_t>(vm["repeats"].as< size_t >(), 1));
+}
@@ -0,0 +1,163 @@
+#ifndef BOUNDARY_FILL_H
+#define BOUNDARY_FILL_H
+
+#include "lattice_accessor.h"
+#include "lattice_field.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstring>
+
+/*
+ *  Fills the bounds (halo) of a field from per face boundary conditions.
+ *
+ *  A field is row-major over the dimensions of its lattice, so the face of dimension d is a set of
+ *  blocks of jump_d contiguous values, each n_d * jump_d apart. Faces are filled block by block with
+ *  memcpy: whole planes for x, rows of z for y in 3D, single values only for the unit stride dimension.
+ *  Dimensions are filled x, then y, then z, so edges and corners end up as if the conditions were
+ *  applied one after another; the two faces of a dimension are filled in parallel.
+ */
+
+namespace Boundary_fill {
+
+    enum class Condition {
+        //Copy of the interior plane at the far side
+        PERIODIC,
+        //Copy of the adjacent interior plane
+        MIRROR,
+        //Fixed value
+        BULK,
+        //Left as it is, e.g. bounds read from a file
+        KEEP
+    };
+
+    struct Face {
+        Condition condition = Condition::MIRROR;
+        //Value of BULK faces
+        double value = 0;
+    };
+
+    //Lower (coordinate 0) and upper (coordinate M+1) face of x, y and z
+    struct Conditions {
+        Face lower[3];
+        Face upper[3];
+    };
+
+    inline Conditions all(Condition condition, double value = 0) {
+        Conditions conditions;
+
+        for (size_t d = 0 ; d < 3 ; ++d) {
+            conditions.lower[d] = {condition, value};
+            conditions.upper[d] = {condition, value};
+        }
+
+        return conditions;
+    }
+
+    //A face as count blocks of length contiguous values, pitch apart, at plane * length in each block
+    struct Face_layout {
+        size_t count;
+        size_t length;
+        size_t pitch;
+        size_t destination;
+        size_t source;
+    };
+
+    inline bool face_layout(const Lattice_accessor& lattice, size_t dimension, bool upper, Condition condition, Face_layout& layout) {
+        const size_t extent[3] = {
+            lattice.MX + 2,
+            lattice.dimensionality > 1 ? lattice.MY + 2 : 1,
+            lattice.dimensionality > 2 ? lattice.MZ + 2 : 1
+        };
+
+        if (dimension >= static_cast<size_t>(lattice.dimensionality))
+            return false;
+
+        layout.count = 1;
+        for (size_t d = 0 ; d < dimension ; ++d)
+            layout.count *= extent[d];
+
+        layout.length = 1;
+        for (size_t d = dimension + 1 ; d < 3 ; ++d)
+            layout.length *= extent[d];
+
+        layout.pitch = extent[dimension] * layout.length;
+
+        const size_t last = extent[dimension] - 2;
+
+        if (upper) {
+            layout.destination = (last + 1) * layout.length;
+            layout.source = (condition == Condition::PERIODIC ? 1 : last) * layout.length;
+        } else {
+            layout.destination = 0;
+            layout.source = (condition == Condition::PERIODIC ? last : 1) * layout.length;
+        }
+
+        return true;
+    }
+
+    //Values first .. last-1 of the face, counted block after block
+    template<typename T>
+    void fill_face_part(T* data, const Face_layout& layout, const Face& face, size_t first, size_t last) noexcept {
+        if (face.condition == Condition::KEEP)
+            return;
+
+        size_t block = first / layout.length;
+        size_t offset = first - block * layout.length;
+
+        while (first < last) {
+            const size_t run = std::min(last - first, layout.length - offset);
+            T* destination = data + block * layout.pitch + layout.destination + offset;
+
+            if (face.condition == Condition::BULK)
+                std::fill_n(destination, run, static_cast<T>(face.value));
+            else if (run == 1)
+                *destination = data[block * layout.pitch + layout.source + offset];
+            else
+                memcpy(destination, data + block * layout.pitch + layout.source + offset, run * sizeof(T));
+
+            first += run;
+            offset = 0;
+            ++block;
+        }
+    }
+
+    //Fills the bounds of a field laid out by lattice (set_jumps called). Runs on pool when one is given.
+    template<typename T>
+    void fill(T* data, const Lattice_accessor& lattice, const Conditions& conditions, Thread_pool* pool = nullptr) {
+        const size_t part_size = Lattice_accessor::PARALLEL_BLOCK_SIZE;
+
+        for (size_t dimension = 0 ; dimension < 3 ; ++dimension) {
+            Face_layout layouts[2];
+            const Face* faces[2] = {&conditions.lower[dimension], &conditions.upper[dimension]};
+
+            if (not face_layout(lattice, dimension, false, faces[0]->condition, layouts[0])
+                or not face_layout(lattice, dimension, true, faces[1]->condition, layouts[1]))
+                break;
+
+            const size_t face_size = layouts[0].count * layouts[0].length;
+            const size_t parts = (face_size + part_size - 1) / part_size;
+
+            if (pool == nullptr or parts == 1) {
+                for (size_t f = 0 ; f < 2 ; ++f)
+                    fill_face_part(data, layouts[f], *faces[f], 0, face_size);
+                continue;
+            }
+
+            pool->parallel_for(2 * parts,
+                [data, &layouts, &faces, face_size, parts, part_size] (size_t task) {
+                    const size_t f = task / parts;
+                    const size_t part = task - f * parts;
+                    fill_face_part(data, layouts[f], *faces[f], part * part_size, std::min(face_size, (part + 1) * part_size));
+                }
+            );
+        }
+    }
+
+    template<typename T>
+    void fill(Lattice_field<T>& field, const Conditions& conditions, Thread_pool* pool = nullptr) {
+        fill(field.data(), field.geometry(), conditions, pool);
+    }
+}
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef BYTE_ORDER_H
+#define BYTE_ORDER_H
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+/*
+ *  Bulk conversion between host and big-endian byte order, as used by legacy binary VTK files.
+ *  Works on whole arrays so the compiler can vectorize the byte swaps.
+ */
+
+namespace Byte_order {
+
+    inline bool host_is_big_endian() noexcept
+    {
+        return __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+    }
+
+    inline uint32_t swap(uint32_t value) noexcept
+    {
+        return __builtin_bswap32(value);
+    }
+
+    inline uint64_t swap(uint64_t value) noexcept
+    {
+        return __builtin_bswap64(value);
+    }
+
+    template<typename T> struct Unsigned_of;
+    template<> struct Unsigned_of<float> { typedef uint32_t type; };
+    template<> struct Unsigned_of<int32_t> { typedef uint32_t type; };
+    template<> struct Unsigned_of<double> { typedef uint64_t type; };
+
+    //Writes count values to output as big-endian bytes, output has to hold count*sizeof(T) bytes.
+    template<typename T>
+    void to_big_endian(const T* input, size_t count, char* output) noexcept
+    {
+        typedef typename Unsigned_of<T>::type Bits;
+
+        if (host_is_big_endian())
+        {
+            memcpy(output, input, count * sizeof(T));
+            return;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            Bits bits;
+            memcpy(&bits, input + i, sizeof(T));
+            bits = swap(bits);
+            memcpy(output + i * sizeof(T), &bits, sizeof(T));
+        }
+    }
+
+    //Reads count big-endian values from input.
+    template<typename T>
+    void from_big_endian(const char* input, size_t count, T* output) noexcept
+    {
+        typedef typename Unsigned_of<T>::type Bits;
+
+        if (host_is_big_endian())
+        {
+            memcpy(output, input, count * sizeof(T));
+            return;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            Bits bits;
+            memcpy(&bits, input + i * sizeof(T), sizeof(T));
+            bits = swap(bits);
+            memcpy(output + i, &bits, sizeof(T));
+        }
+    }
+}
+
+#endif
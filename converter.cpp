@@ -0,0 +1,266 @@
+#include "file_reader.h"
+#include "file_writer.h"
+#include "lattice_accessor.h"
+#include "series_reader.h"
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/filesystem.hpp>
+
+using namespace boost;
+using namespace boost::program_options;
+
+#include <iostream>
+#include <exception>
+#include <vector>
+#include <map>
+#include <memory>
+#include <regex>
+
+using namespace std;
+
+//components hold a value for every index of lattice, e.g. where a sidecar cache is mapped
+void write_components(const variables_map& vm, Lattice_accessor lattice, const vector<string>& names, const vector<const double*>& components, Writable_file out_file)
+{
+    cout << "Read " << components.size() << " components of " << lattice.MX;
+    if (lattice.dimensionality > 1)
+        cout << " x " << lattice.MY;
+    if (lattice.dimensionality > 2)
+        cout << " x " << lattice.MZ;
+    cout << " voxels." << endl;
+
+    auto profile_writer = Profile_writer::Factory::Create(out_file.get_filetype(), &lattice, out_file);
+
+    profile_writer->configuration.number_format = Profile_writer::number_formats[vm["number-format"].as< string >()];
+    profile_writer->configuration.compression_level = vm["compression"].as< int >();
+    profile_writer->configuration.tile = vm["tile"].as< size_t >();
+    profile_writer->configuration.queued_io = vm.count("queued-io");
+
+    if (vm.count("no-bounds"))
+        profile_writer->configuration.boundary_mode = IProfile_writer::Boundary_mode::WITHOUT_BOUNDS;
+
+    std::map<string, std::shared_ptr<IOutput_ptr>> profiles;
+
+    for (size_t i = 0 ; i < components.size() ; ++i)
+        profiles[names[i]] = std::make_shared<Output_ptr<const double>>(components[i]);
+
+    profile_writer->bind_data(profiles);
+
+    profile_writer->prepare_for_data();
+
+    profile_writer->write();
+}
+
+void write_components(const variables_map& vm, Lattice_accessor lattice, const vector<string>& names, vector<vector<double>>& components, Writable_file out_file)
+{
+    vector<const double*> data;
+
+    //The writers expect a value for every index of the lattice, the .pro reader stores fewer in 1D and 2D
+    for (vector<double>& component : components) {
+        component.resize(lattice.system_size, 0.0);
+        data.push_back(component.data());
+    }
+
+    write_components(vm, lattice, names, data, out_file);
+}
+
+//Refuses to write over a file being converted, as a series converted to its own format would
+void check_distinct(const string& input, const string& output)
+{
+    system::error_code error;
+
+    if (input == output or filesystem::equivalent(input, output, error)) {
+        cerr << "Output file " << output << " is the input file, refusing to overwrite it." << endl;
+        exit(0);
+    }
+}
+
+int main(int argc , char **argv)
+{
+    options_description desc("\nConvert a .pro, .vtk or .nlc file to another format, by default the native .nlc container,\nwhich later reads map instead of parse.\nAllowed arguments");
+
+    desc.add_options()
+        ("help,h", "Print this help text.")
+        ("input-file,i", value< string >(), "Specifies input file, pro, vtk or nlc format.")
+        ("out-type,o", value< string >()->default_value("nlc"), "Specifies output file type (nlc, vtk_structured_grid, vtk_structured_points, vtk_structured_grid_binary, vtk_structured_points_binary, vtk_binary, vti, or pro).")
+        ("tile,t", value< size_t >()->default_value(0), "[int] nlc only: store components in tiles of this many voxels along every dimension, so parts of the lattice read on their own. 0 stores them whole.")
+        ("no-bounds,b", "nlc only: store the interior of the lattice, without bounds.")
+        ("last,l", value< size_t >(), "[int] Convert the series [stem]_[n].[ext] from the input file's n through this one into [stem]_converted_[n].[ext], loading the next files while writing.")
+        ("lookahead,a", value< size_t >()->default_value(Series_reader::DEFAULT_LOOKAHEAD), "[int] Files of a series loaded ahead.")
+        ("memory,m", value< size_t >()->default_value(0), "[int] MiB a series may load ahead, 0 for no limit but lookahead.")
+        ("threads,j", value< size_t >()->default_value(1), "[int] Threads parsing ASCII files.")
+        ("compression,c", value< int >()->default_value(0), "[int] zlib compression level (1-9) for output types that support it, 0 disables compression.")
+        ("number-format,f", value< string >()->default_value("fixed"), "Number format of text output (fixed, shortest or float).")
+        ("queued-io,q", "Read and write with large queued requests, io_uring where the kernel allows it, instead of mapping the input.")
+        ("sidecar-cache,s", "Keep the parsed input in [file].cache and map that instead of parsing the next time.")
+        ("stream", "Single files without a sidecar cache: read the input one component at a time instead of all at once.")
+        ("reorder-while-parsing,r", ".pro series and sidecar cache reads: store every value at its lattice index while parsing, instead of reordering all data afterwards. Other reads always do.");
+
+    positional_options_description p;
+    p.add("input-file", -1);
+
+    variables_map vm;
+    try
+    {
+        store( command_line_parser( argc, argv).options(desc).positional(p).run(), vm );
+        notify(vm);
+
+    } catch (std::exception &e)
+    {
+        cerr << endl << e.what() << endl;
+        cerr << desc << endl;
+    }
+
+    if (vm.count("help")) {
+        cerr << desc << endl;
+        exit(0);
+    }
+
+    if (!vm.count("input-file")) {
+        cerr << "No input file specified." << endl;
+        exit(0);
+    }
+
+    if (Profile_writer::output_options.count(vm["out-type"].as< string >()) == 0) {
+        cerr << "Output type not recognized, please refer to help file" << endl;
+        exit(0);
+    }
+
+    if (Profile_writer::number_formats.count(vm["number-format"].as< string >()) == 0) {
+        cerr << "Unknown number format: " << vm["number-format"].as< string >() << endl;
+        exit(0);
+    }
+
+    if (vm.count("stream") and (vm.count("last") or vm.count("sidecar-cache"))) {
+        cerr << "--stream only reads single files, without --last or --sidecar-cache." << endl;
+        exit(0);
+    }
+
+    filesystem::path filename = vm["input-file"].as< string >();
+    auto out_filetype = Profile_writer::output_options[ vm["out-type"].as< string >() ];
+    const IReader::Read_mode read_mode = vm.count("queued-io") ? IReader::Read_mode::QUEUED : IReader::Read_mode::MEMORY_MAPPED;
+
+    if (vm.count("last")) {
+        //stem_n.ext, as Writable_file numbers a series
+        const regex numbered("(.*)_([0-9]+)");
+        smatch match;
+        const string stem = filename.stem().string();
+
+        if (not regex_match(stem, match, numbered)) {
+            cerr << "Input file " << filename.string() << " is not numbered as [stem]_[n].[ext]." << endl;
+            exit(0);
+        }
+
+        const string base = (filename.parent_path() / match[1].str()).string();
+        const size_t first = stoul(match[2].str());
+
+        const string series_extension = filename.extension().string().substr(1);
+
+        Series_reader series(base, series_extension, first, vm["last"].as< size_t >());
+        series.configuration.lookahead = vm["lookahead"].as< size_t >();
+        series.configuration.memory_budget = vm["memory"].as< size_t >() << 20;
+        series.configuration.reader.read_mode = read_mode;
+        series.configuration.reader.threads = vm["threads"].as< size_t >();
+        series.configuration.reader.sidecar_cache = vm.count("sidecar-cache");
+        series.configuration.reader.reorder_while_parsing = vm.count("reorder-while-parsing");
+
+        //Numbered like the input, under a stem of their own
+        const string out_stem = match[1].str() + "_converted";
+
+        for (size_t identifier = first ; identifier <= vm["last"].as< size_t >() ; ++identifier)
+            check_distinct(Series_reader::filename(base, series_extension, identifier), Writable_file(out_stem, out_filetype, identifier).get_filename());
+
+        Series_reader::Snapshot snapshot;
+        size_t identifier = first;
+
+        for (;; ++identifier) {
+            try {
+                if (not series.next(snapshot))
+                    break;
+            } catch (...) {
+                cerr << "Could not read " << Series_reader::filename(base, series_extension, identifier) << ", stopping the series there." << endl;
+                return 1;
+            }
+
+            //The writers report their own errors
+            try {
+                write_components(vm, snapshot.lattice, snapshot.names, snapshot.components, Writable_file(out_stem, out_filetype, snapshot.identifier));
+            } catch (int) {
+                return 1;
+            }
+        }
+
+        return 0;
+    }
+
+    const Readable_filetype in_filetype = Readable_file::filetype_of(filename.string());
+
+    if (in_filetype == Readable_filetype::NONE) {
+        cerr << "Input type of " << filename.string() << " not recognized, expected .pro, .vtk or .nlc." << endl;
+        exit(0);
+    }
+
+    Readable_file in_file(filename.string(), in_filetype);
+
+    Reader in_reader;
+    in_reader.configuration.read_mode = read_mode;
+    in_reader.configuration.threads = vm["threads"].as< size_t >();
+    in_reader.configuration.sidecar_cache = vm.count("sidecar-cache");
+    in_reader.configuration.reorder_while_parsing = vm.count("reorder-while-parsing");
+
+    IReader& input = vm.count("stream") ? in_reader.stream_objects_in(in_file) : in_reader.open(in_file);
+
+    Writable_file out_file(filename.stem().string(), out_filetype);
+    check_distinct(filename.string(), out_file.get_filename());
+
+    vector<vector<double>> components;
+
+    if (vm.count("sidecar-cache")) {
+        const unique_ptr<const Sidecar::Mapping> mapping = input.map_through_cache(components);
+
+        if (mapping) {
+            //Written where the cache is mapped, unless the .pro reader stored fewer values than the lattice has
+            if (mapping->values() >= mapping->lattice().system_size) {
+                vector<const double*> data;
+
+                for (size_t i = 0 ; i < mapping->names().size() ; ++i)
+                    data.push_back(mapping->component(i));
+
+                write_components(vm, mapping->lattice(), mapping->names(), data, out_file);
+                return 0;
+            }
+
+            components.resize(mapping->names().size());
+
+            for (size_t i = 0 ; i < components.size() ; ++i)
+                components[i].assign(mapping->component(i), mapping->component(i) + mapping->values());
+        }
+
+        write_components(vm, input.lattice(), input.m_headers, components, out_file);
+        return 0;
+    }
+
+    if (vm.count("stream")) {
+        components.emplace_back();
+
+        while (input.next_component(components.back()))
+            components.emplace_back();
+
+        components.pop_back();
+
+        write_components(vm, input.lattice(), input.m_headers, components, out_file);
+        return 0;
+    }
+
+    //Fields hold every value of the lattice, so they are written where they were parsed to
+    vector<Lattice_field<double>> fields;
+    input.read_fields(fields);
+
+    vector<const double*> data;
+
+    for (const Lattice_field<double>& field : fields)
+        data.push_back(field.data());
+
+    write_components(vm, input.lattice(), input.m_headers, data, out_file);
+}
@@ -0,0 +1,51 @@
+#ifndef DIVIDER_H
+#define DIVIDER_H
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ *  Division by a divisor fixed at runtime, strength reduced to multiplications.
+ *
+ *  Uses a 128 bit reciprocal M = ceil(2^128 / d), for which n / d == (M * n) >> 128 holds for all 64 bit n
+ *  (Lemire, Kaser, Kurz, "Faster remainder by direct computation", 2019).
+ */
+
+class Divider {
+    public:
+        Divider(size_t divisor = 1) noexcept
+        : m_divisor{divisor}, m_reciprocal{divisor > 1 ? ~static_cast<unsigned __int128>(0) / divisor + 1 : 0}
+        {
+        }
+
+        size_t divisor() const noexcept
+        {
+            return m_divisor;
+        }
+
+        size_t quotient(size_t n) const noexcept
+        {
+            if (m_reciprocal == 0)
+                return n;
+
+            const uint64_t high = static_cast<uint64_t>(m_reciprocal >> 64);
+            const uint64_t low = static_cast<uint64_t>(m_reciprocal);
+
+            const unsigned __int128 product = static_cast<unsigned __int128>(high) * n
+                + ((static_cast<unsigned __int128>(low) * n) >> 64);
+
+            return static_cast<size_t>(product >> 64);
+        }
+
+        size_t remainder(size_t n) const noexcept
+        {
+            return n - quotient(n) * m_divisor;
+        }
+
+    private:
+        size_t m_divisor;
+        //0 for divisor 1, whose reciprocal does not fit
+        unsigned __int128 m_reciprocal;
+};
+
+#endif
@@ -5,25 +5,24 @@ constexpr uint8_t HALO = 1;
 /******* Edge_finder ********/
 // TODO: expects rho including boundaries!
 
-Edge_finder::Edge_finder(Lattice_accessor& geometry, int threshold)
-  : threshold{threshold}, geometry{geometry}
+Edge_finder::Edge_finder(Lattice_accessor& geometry, int threshold, size_t threads)
+  : threshold{threshold}, geometry{geometry}, pool{threads}
 {
 }
 
 Edge_finder::~Edge_finder() {
 }
 
-int Edge_finder::detect_edges(const vector<double>& rho, size_t threshold) {
-  edges.clear();
+int Edge_finder::detect_edges(const Lattice_field<double>& rho, size_t threshold) {
   //vector<double> temp((MX-3)*(MY-3)*(MZ-3));
   //temp = gaussian_blur(component[0]->rho);
   edges = sobel_edge_detector(rho, threshold);
   return 0;
 }
 
-vector<double> Edge_finder::sobel_edge_detector(const vector<double>& rho, size_t tolerance) {
+Lattice_field<double> Edge_finder::sobel_edge_detector(const Lattice_field<double>& rho, size_t tolerance) {
   //TODO: Generalize to 2D and 1D or add warning?
-  vector<double> result( rho.size() );
+  Lattice_field<double> result(rho.geometry());
   size_t threshold = tolerance;
 
   vector<double> Gx_minus = {-1, -3, -1, -3, -6, -3, -1, -3, -1};
@@ -38,47 +37,54 @@ vector<double> Edge_finder::sobel_edge_detector(const vector<double>& rho, size_
   vector<double> Gz_mid = {3, 6, 3, 0, 0, 0, -3, -6, -3};
   vector<double> Gz_plus = {1, 3, 1, 0, 0, 0, -1, -3, -1};
 
-  int i{0};
-
-  for (size_t x = 0; x < geometry.MX; ++x)
-    for (size_t y = 0; y < geometry.MY; ++y)
-      for (size_t z = 0 ; z < geometry.MZ; ++z ) {
-
-        double conv_x = convolution(Gx_minus, get_xy_plane(rho, x, y, z));
-        conv_x += convolution(Gx_mid, get_xy_plane(rho, x, y, z+1));
-        conv_x += convolution(Gx_plus, get_xy_plane(rho, x, y, z+2));
+  //Every voxel only writes itself, kernels start one voxel before it in every dimension
+  geometry.parallel_for_each(pool, geometry.inside(), [&] (size_t x, size_t y, size_t z, size_t) {
+        double conv_x = convolution(Gx_minus, get_xy_plane(rho, x-1, y-1, z-1));
+        conv_x += convolution(Gx_mid, get_xy_plane(rho, x-1, y-1, z));
+        conv_x += convolution(Gx_plus, get_xy_plane(rho, x-1, y-1, z+1));
 
-        double conv_y = convolution(Gy_minus, get_xy_plane(rho, x, y, z));
-        conv_y += convolution(Gy_mid, get_xy_plane(rho, x, y, z+1));
-        conv_y += convolution(Gy_plus, get_xy_plane(rho, x, y, z+2));
+        double conv_y = convolution(Gy_minus, get_xy_plane(rho, x-1, y-1, z-1));
+        conv_y += convolution(Gy_mid, get_xy_plane(rho, x-1, y-1, z));
+        conv_y += convolution(Gy_plus, get_xy_plane(rho, x-1, y-1, z+1));
 
-        double conv_z = convolution(Gz_minus, get_xz_plane(rho, x, y, z));
-        conv_z += convolution(Gz_mid, get_xz_plane(rho, x, y+1, z));
-        conv_z += convolution(Gz_plus, get_xz_plane(rho, x, y+2, z));
+        double conv_z = convolution(Gz_minus, get_xz_plane(rho, x-1, y-1, z-1));
+        conv_z += convolution(Gz_mid, get_xz_plane(rho, x-1, y, z-1));
+        conv_z += convolution(Gz_plus, get_xz_plane(rho, x-1, y+1, z-1));
 
-        *geometry.val_ptr(result, x+1, y+1, z+1) = abs(conv_x) + abs(conv_y) + abs(conv_z);
-
-        ++i;
-    }
+        result(x, y, z) = abs(conv_x) + abs(conv_y) + abs(conv_z);
+  });
 
   //normalize between 0 and 255
-  double min = *min_element(result.begin(), result.end());
-  double max = *max_element(result.begin(), result.end());
+  const Lattice_accessor& lattice = result.geometry();
+
+  const pair<double, double> extremes = lattice.parallel_reduce(pool, lattice.plus_bounds(),
+    make_pair(result[0], result[0]),
+    [&result] (pair<double, double>& extremes, size_t, size_t, size_t, size_t index) {
+        extremes.first = std::min(extremes.first, result[index]);
+        extremes.second = std::max(extremes.second, result[index]);
+    },
+    [] (pair<double, double> extremes, const pair<double, double>& block) {
+        return make_pair(std::min(extremes.first, block.first), std::max(extremes.second, block.second));
+    }
+  );
 
-  for (double& all_elements : result)
-    all_elements = (255 - 0) * ((all_elements - min) / (max - min)) + 0;
+  const double min = extremes.first;
+  const double max = extremes.second;
 
   //cut-off at threshold
-  for (double& all_elements : result)
-    if (all_elements < threshold) {
-      all_elements = 0;
-    }
+  lattice.parallel_for_each(pool, lattice.plus_bounds(), [&result, min, max, threshold] (size_t, size_t, size_t, size_t index) {
+        double& value = result[index];
+        value = (255 - 0) * ((value - min) / (max - min)) + 0;
+
+        if (value < threshold)
+          value = 0;
+  });
 
   return result;
 }
 
-vector<double> Edge_finder::gaussian_blur(const vector<double>& rho) {
-  vector<double> result( (geometry.MX-HALO)*(geometry.MY-HALO)*(geometry.MY-HALO) );
+vector<double> Edge_finder::gaussian_blur(const Lattice_field<double>& rho) {
+  vector<double> result( (geometry.MX-HALO)*(geometry.MY-HALO)*(geometry.MZ-HALO) );
   vector<double> G1 = {1, 2, 1, 2, 4, 2, 1, 2, 1};
   vector<double> G2 = {1, 1, 1, 1, 2, 1, 1, 1, 1};
   vector<double> G3 = {1, 1, 1, 1, 2, 1, 1, 1, 1};
@@ -120,28 +126,28 @@ double Edge_finder::convolution(const vector<double>& kernel, const vector<doubl
   return accumulator;
 }
 
-vector<double> Edge_finder::get_xy_plane(const vector<double>& rho, int x, int y, int z, int size) {
+vector<double> Edge_finder::get_xy_plane(const Lattice_field<double>& rho, int x, int y, int z, int size) {
   vector<double> pixel(size*size);
 
   int i = 0;
 
   for (int horizontal = 0 ; horizontal < size ; ++horizontal)
     for (int vertical = 0 ; vertical < size ; ++vertical) {
-        pixel[i] = geometry.val(const_cast<vector<double>&>(rho), x+horizontal, y+vertical, z);
+        pixel[i] = rho(x+horizontal, y+vertical, z);
         ++i;
     }
 
   return pixel;
 }
 
-vector<double> Edge_finder::get_xz_plane(const vector<double>& rho, int x, int y, int z, int size) {
+vector<double> Edge_finder::get_xz_plane(const Lattice_field<double>& rho, int x, int y, int z, int size) {
   vector<double> pixel(size*size);
 
   int i = 0;
 
   for (int horizontal = 0 ; horizontal < size ; ++horizontal)
     for (int depth = 0 ; depth < size ; ++depth) {
-        pixel[i] = geometry.val(const_cast<vector<double>&>(rho), x+horizontal, y, z+depth);
+        pixel[i] = rho(x+horizontal, y, z+depth);
         ++i;
     }
 
@@ -3,6 +3,8 @@
 
 #include <vector>
 #include "lattice_accessor.h"
+#include "lattice_field.h"
+#include "thread_pool.h"
 #include <algorithm>
 #include <iostream>
 
@@ -10,20 +12,21 @@ using namespace std;
 
 class Edge_finder {
 public:
-  Edge_finder(Lattice_accessor&, int threshold);
+  Edge_finder(Lattice_accessor&, int threshold, size_t threads = Thread_pool::default_thread_count());
   ~Edge_finder();
-  int detect_edges(const vector<double>&, size_t);
+  int detect_edges(const Lattice_field<double>&, size_t);
 
-  vector<double> edges;
+  Lattice_field<double> edges;
   const int threshold;
 
 private:
   Lattice_accessor geometry;
-  vector<double> sobel_edge_detector(const vector<double>&, size_t);
-  vector<double> gaussian_blur(const vector<double>&);
+  Thread_pool pool;
+  Lattice_field<double> sobel_edge_detector(const Lattice_field<double>&, size_t);
+  vector<double> gaussian_blur(const Lattice_field<double>&);
   double convolution(const vector<double>&, const vector<double>&);
-  vector<double> get_xy_plane(const vector<double>&, int, int, int, int = 3);
-  vector<double> get_xz_plane(const vector<double>&, int, int, int, int = 3);
+  vector<double> get_xy_plane(const Lattice_field<double>&, int, int, int, int = 3);
+  vector<double> get_xz_plane(const Lattice_field<double>&, int, int, int, int = 3);
 };
 
 #endif
@@ -1,4 +1,6 @@
 #include "expander.h"
+#include "boundary_fill.h"
+#include "async_profile_writer.h"
 
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/parsers.hpp>
@@ -34,10 +36,18 @@ int main(int argc , char **argv)
         ("y-dimension,y", value< int >(), "[int] Y size to expand to (without bounds).")
         ("z-dimension,z", value< int >(), "[int] Z size to expand to (without bounds).")
         ("preserve,p", value< bool >()->default_value(false), "[bool] Preserve bounds in the dimension being read.")
+        ("bounds,b", value< string >()->default_value("mirror"), "Condition the y and z bounds written with --preserve are filled with after adding noise (mirror or periodic).")
         ("input-file,i", value< string >(), "Specifies input file, must be pro format.")
-        ("out-type,o", value< string >()->default_value("vtk"), "Specifies output file type (vtk_structured_grid, vtk_structured_points, or pro).")
+        ("out-type,o", value< string >()->default_value("vtk"), "Specifies output file type (vtk_structured_grid, vtk_structured_points, vtk_structured_grid_binary, vtk_structured_points_binary, vtk_binary, vti, or pro).")
+        ("compression,c", value< int >()->default_value(0), "[int] zlib compression level (1-9) for output types that support it, 0 disables compression.")
+        ("number-format,f", value< string >()->default_value("fixed"), "Number format of text output (fixed: 14 significant digits, shortest: fewest digits that read back exactly, float: fewest digits that read back as the same float).")
         ("theta,t", value<vector<size_t>>()->multitoken(), "[int] [int] ... Sum and print theta of multiple components: index starts at 0, separated by spaces. Print multiple theta's by using this flag multiple times, e.g. -t 0 1 -t 2.")
-        ("noise,n", value< double >(), "[double] Adds noise of given stddev to your perfectly smooth equilibrium profiles.");
+        ("noise,n", value< double >(), "[double] Adds noise of given stddev to your perfectly smooth equilibrium profiles.")
+        ("threads,j", value< size_t >()->default_value(Thread_pool::default_thread_count()), "[int] Threads adding noise and summing theta.")
+        ("seed", value< unsigned >(), "[int] Seed of the noise, the same seed gives the same noise for any number of threads. Random by default.")
+        ("async,a", "Write the output on a background thread.")
+        ("queued-io,q", "Read and write with large queued requests, io_uring where the kernel allows it.")
+        ("sidecar-cache,s", "Keep the parsed input in [file].cache and read that instead of parsing the next time.");
 
     // Map positional parameters to their tag valued types 
     positional_options_description p;
@@ -83,6 +93,8 @@ int main(int argc , char **argv)
         lattice.dimensionality = static_cast<Dimensionality>(3);
     }
 
+    Thread_pool pool(vm["threads"].as< size_t >());
+
     auto map_it = Profile_writer::output_options.find(vm["out-type"].as< string >());
 
     if (map_it == Profile_writer::output_options.end())
@@ -94,12 +106,16 @@ int main(int argc , char **argv)
     Readable_file in_file(filename.string(),Readable_filetype::PRO);
 
     Reader* in_reader = new Reader;
-    size_t num_read_objects = in_reader->read_objects_in(in_file);
+
+    if (vm.count("queued-io"))
+        in_reader->configuration.read_mode = IReader::Read_mode::QUEUED;
+
+    in_reader->configuration.sidecar_cache = vm.count("sidecar-cache");
 
     // Should really have used a deque here, but namics only likes vectors so this
     // is compatible with the file reader from namics
-    vector<vector<double>> input_densities(num_read_objects);
-    in_reader->push_data_to_objects(input_densities);
+    vector<vector<double>> input_densities;
+    in_reader->read_objects_in(in_file, input_densities);
 
     vector<string> headers = in_reader->get_headers();
 
@@ -135,13 +151,22 @@ int main(int argc , char **argv)
     variables_map vml;
     store(parsed_options, vml);
 
+    //The profiles read are 1D, a row of one voxel per value
+    Lattice_accessor profile_lattice;
+    profile_lattice.set_jumps();
+
     for (auto list : lists) {
         double sum_theta_output{0.0};
 
         for (auto component_string : list) {
             size_t component = atoi(component_string.c_str());
             if (component < input_densities.size()) {
-                sum_theta_output = std::accumulate(input_densities[component].begin(), input_densities[component].end(), sum_theta_output);
+                const vector<double>& profile = input_densities[component];
+
+                sum_theta_output += profile_lattice.parallel_reduce(pool, {0, profile.size(), 0, 1, 0, 1}, 0.0,
+                    [&profile] (double& sum, size_t, size_t, size_t, size_t index) { sum += profile[index]; },
+                    [] (double sum, double block) { return sum + block; }
+                );
             } else {
                 cerr << "Component " << component << " is out of range! Exiting." << endl;
                 exit(0);
@@ -166,11 +191,11 @@ int main(int argc , char **argv)
     lattice.set_jumps();
 
     /***** MULTIPLY SYSTEM IN Y AND Z DIRECTIONS *****/
-    vector<vector<double>> output_densities(input_densities.size());
+    vector<Lattice_field<double>> output_densities;
     int stride = (lattice.MZ+BOUNDARIES)*(lattice.MY+BOUNDARIES);
 
     for (size_t j = 0 ; j < input_densities.size() ; ++j) {
-        output_densities[j].resize( lattice.system_size );
+        output_densities.emplace_back(lattice);
         for (size_t z = 0 ; z < input_densities[j].size() ; ++z) {
             for (size_t i = z*stride ; i < z*stride+stride ; ++i) {
                 output_densities[j][i] = input_densities[j][z];
@@ -180,28 +205,74 @@ int main(int argc , char **argv)
 
     if (vm.count("noise")) {
         /***** NOISE THE CRAP OUT OF THE PROFILE *****/
-        std::minstd_rand prng { std::random_device{}() };
         double mean = 0;
         double stddev =  vm["noise"].as< double >();
-        std::normal_distribution<double> dist{mean, stddev};
+        const std::normal_distribution<double>::param_type parameters{mean, stddev};
+        const unsigned seed = vm.count("seed") ? vm["seed"].as< unsigned >() : std::random_device{}();
+        const Lattice_accessor::Range all = lattice.plus_bounds();
+
+        cout << "Noise seed: " << seed << endl;
+
+        //Quantity moves from every voxel to any voxel of the profile. Targets and shifts are drawn in parallel from
+        //the profile before noise, each z row with a generator of its own, so they don't depend on the thread
+        //count. The transfers are applied afterwards, in index order.
+        vector<size_t> targets(lattice.system_size);
+        vector<double> shifts(lattice.system_size);
 
         for (auto& profile : output_densities) {
-            for (auto& value : profile) {
-                int output_index = (rand() % static_cast<int>(profile.size() + 1));
-                double shift_quantity = value * dist(prng);
+            lattice.parallel_for_each(pool, all, [&] (size_t x, size_t y, size_t z, size_t index) {
+                thread_local std::minstd_rand prng;
+                thread_local std::normal_distribution<double> dist;
+                std::uniform_int_distribution<size_t> anywhere{0, profile.size() - 1};
+
+                //Rows are never split over threads and are visited in order
+                if (z == all.z_begin) {
+                    std::seed_seq row_seed {seed, static_cast<unsigned>(x), static_cast<unsigned>(y)};
+                    prng.seed(row_seed);
+                    dist.reset();
+                }
+
+                const double value = profile[index];
+                size_t output_index = anywhere(prng);
+                double shift_quantity = value * dist(prng, parameters);
                 double output_quantity = profile[output_index] + shift_quantity;
                 double input_quantity = value - shift_quantity;
 
                 while (not (output_quantity < 1.0 or output_quantity > 0.0) and (input_quantity < 1.0 or input_quantity > 0.0)) {
-                    output_index = (rand() % static_cast<int>(profile.size() + 1));
-                    shift_quantity = value * dist(prng);
+                    output_index = anywhere(prng);
+                    shift_quantity = value * dist(prng, parameters);
                     output_quantity = profile[output_index] + shift_quantity;
                     input_quantity = value - shift_quantity;
                 }
 
-                profile[output_index] += shift_quantity;
-                value -= shift_quantity;
+                targets[index] = output_index;
+                shifts[index] = shift_quantity;
+            });
+
+            for (size_t index = 0 ; index < profile.size() ; ++index) {
+                profile[targets[index]] += shifts[index];
+                profile[index] -= shifts[index];
+            }
+        }
+
+        //Noise reaches the bounds as well, refill them from the noised interior. x keeps the bounds of the input.
+        if (vm["preserve"].as< bool >() == true) {
+            const map<string, Boundary_fill::Condition> conditions {
+                {"mirror", Boundary_fill::Condition::MIRROR},
+                {"periodic", Boundary_fill::Condition::PERIODIC}
+            };
+
+            if (conditions.count(vm["bounds"].as< string >()) == 0) {
+                cerr << "Unknown boundary condition: " << vm["bounds"].as< string >() << endl;
+                exit(0);
             }
+
+            Boundary_fill::Conditions bounds = Boundary_fill::all(conditions.at(vm["bounds"].as< string >()));
+            bounds.lower[0].condition = Boundary_fill::Condition::KEEP;
+            bounds.upper[0].condition = Boundary_fill::Condition::KEEP;
+
+            for (auto& profile : output_densities)
+                Boundary_fill::fill(profile, bounds);
         }
     }
 
@@ -226,10 +297,23 @@ int main(int argc , char **argv)
     Writable_file out_file(filename.stem().string() + "_expanded", out_filetype);
     auto profile_writer = Profile_writer::Factory::Create(out_filetype, &lattice, out_file);
 
+    if (vm.count("async"))
+        profile_writer = std::make_shared<Async_profile_writer>(profile_writer, &lattice, out_file);
+
     if (vm["preserve"].as< bool >() == true) {
         profile_writer->configuration.boundary_mode = IProfile_writer::Boundary_mode::WITH_BOUNDS;
     }
 
+    profile_writer->configuration.compression_level = vm["compression"].as< int >();
+    profile_writer->configuration.queued_io = vm.count("queued-io");
+
+    if (Profile_writer::number_formats.count(vm["number-format"].as< string >()) == 0) {
+        cerr << "Unknown number format: " << vm["number-format"].as< string >() << endl;
+        exit(0);
+    }
+
+    profile_writer->configuration.number_format = Profile_writer::number_formats[vm["number-format"].as< string >()];
+
     for (size_t i = 0 ; i < output_densities.size() ; ++i)
         register_output_profile(headers[i], output_densities[i].data());
 
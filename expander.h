@@ -4,6 +4,7 @@
 #include "file_reader.h"
 #include "file_writer.h"
 #include "lattice_accessor.h"
+#include "lattice_field.h"
 
 #include <memory>
 #include <map>
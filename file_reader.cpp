@@ -1,6 +1,8 @@
 #include "file_reader.h"
 
 #include <iomanip>
+#include <limits>
+#include <sys/stat.h>
 
 using namespace std;
 
@@ -12,11 +14,31 @@ constexpr uint8_t X_DIMENSION = 0;
 constexpr uint8_t Y_DIMENSION = 1;
 constexpr uint8_t Z_DIMENSION = 2;
 constexpr uint8_t OFFSET_VTK_DIMENSIONS_TAG = 1;
+constexpr const char* VTK_DIMENSIONS_TAG = "DIMENSIONS";
+constexpr const char* VTK_DIMENSIONALITY_TAG = "dimensionality";
+constexpr const char* VTK_SCALARS_TAG = "SCALARS";
+constexpr const char* VTK_LOOKUP_TABLE_TAG = "LOOKUP_TABLE";
+constexpr const char* VTK_POINTS_TAG = "POINTS";
+constexpr const char* VTK_BINARY_TAG = "BINARY";
+constexpr uint8_t VTK_ENCODING_LINE = 3;
+//Tile edge of the blocked transpose in adjust_indexing, 32x32 doubles (8 KiB) per tile
+constexpr size_t TRANSPOSE_BLOCK = 32;
+//Values converted at a time from a binary VTK block
+constexpr size_t BINARY_CHUNK = 1 << 16;
+//Bytes parsed per task while the rest of a .pro file is still being read
+constexpr size_t READ_AHEAD_PART = 4 << 20;
+//Bytes waited for at a time while looking for the end of a line
+constexpr size_t LINE_SCAN = 1 << 16;
+constexpr const char* VTK_BLOCK_INDEX_EXTENSION = ".idx";
+constexpr const char* VTK_BLOCK_INDEX_TAG = "vtk_block_index";
+constexpr int VTK_BLOCK_INDEX_VERSION = 1;
 
 std::map<Readable_filetype, std::string> Readable_file::extension_map  {
             {Readable_filetype::NONE, ""},
             {Readable_filetype::VTK_STRUCTURED_GRID, "vtk"},
-            {Readable_filetype::PRO, "pro"}
+            {Readable_filetype::VTK_STRUCTURED_GRID_BINARY, "vtk"},
+            {Readable_filetype::PRO, "pro"},
+            {Readable_filetype::LATTICE_CONTAINER, "nlc"}
 };
 
 Readable_filetype Readable_file::get_filetype()
@@ -45,6 +67,31 @@ Readable_file::Readable_file(const std::string filename_, Readable_filetype file
     }
 }
 
+Readable_filetype Readable_file::filetype_of(const std::string& filename)
+{
+    const std::string extension = filename.substr(filename.find_last_of(".") + 1);
+
+    if (extension == extension_map[Readable_filetype::PRO])
+        return Readable_filetype::PRO;
+
+    if (extension == extension_map[Readable_filetype::LATTICE_CONTAINER])
+        return Readable_filetype::LATTICE_CONTAINER;
+
+    if (extension != extension_map[Readable_filetype::VTK_STRUCTURED_GRID])
+        return Readable_filetype::NONE;
+
+    std::ifstream file(filename);
+    std::string line;
+
+    for (uint8_t i = 0; i < VTK_ENCODING_LINE; ++i)
+        getline(file, line);
+
+    if (line.compare(0, strlen(VTK_BINARY_TAG), VTK_BINARY_TAG) == 0)
+        return Readable_filetype::VTK_STRUCTURED_GRID_BINARY;
+
+    return Readable_filetype::VTK_STRUCTURED_GRID;
+}
+
 void Readable_file::check_filetype()
 {
     read_extension();
@@ -70,13 +117,303 @@ void Readable_file::read_extension()
     }
 }
 
+//Splits [first, last) in at most parts ranges, each one ending right after a newline.
+std::vector<Text_range> split_at_lines(const char* first, const char* last, const size_t parts)
+{
+    std::vector<Text_range> ranges;
+    const size_t part_size = (last - first) / std::max<size_t>(parts, 1) + 1;
+
+    while (first != last)
+    {
+        const char* split = first + std::min<size_t>(part_size, last - first);
+        split = Number_parser::next_line(split - 1, last);
+
+        ranges.emplace_back(first, split);
+        first = split;
+    }
+
+    return ranges;
+}
+
+//Start of the first line after split - 1, as split_at_lines splits, waiting for the bytes of file it takes to find
+static const char* line_start_at(const Mapped_file& file, const char* first, const char* split, const char* last)
+{
+    if (split <= first or split >= last)
+        return std::min(std::max(split, first), last);
+
+    for (const char* window = split ; ; )
+    {
+        window = window + std::min<size_t>(LINE_SCAN, last - window);
+        file.wait_for(split - 1, window);
+
+        const char* const start = Number_parser::next_line(split - 1, window);
+
+        if (start != window or window == last)
+            return start;
+    }
+}
+
+size_t line_parts(const Mapped_file& file, const char* first, const char* last, const size_t threads)
+{
+    const size_t parts = std::max<size_t>(threads, 1);
+
+    if (file.loaded())
+        return parts;
+
+    return std::max(parts, static_cast<size_t>(last - first) / READ_AHEAD_PART + 1);
+}
+
+Text_range line_part(const Mapped_file& file, const char* first, const char* last, const size_t parts, const size_t part)
+{
+    const size_t size = last - first;
+    const size_t part_size = size / std::max<size_t>(parts, 1) + 1;
+
+    const Text_range range {
+        line_start_at(file, first, first + std::min(size, part * part_size), last),
+        line_start_at(file, first, first + std::min(size, (part + 1) * part_size), last)
+    };
+
+    file.wait_for(range.first, range.second);
+    return range;
+}
+
+//Calls function(line) for every line, without '\n' or '\r\n', until it returns false
+template<typename Function>
+static void for_each_line(const char* position, const char* const end, Function function)
+{
+    while (position != end)
+    {
+        const char* next = Number_parser::next_line(position, end);
+
+        Line_scanner::Line line {position, next};
+        if (line.end != line.begin and *(line.end - 1) == '\n')
+            --line.end;
+        if (line.end != line.begin and *(line.end - 1) == '\r')
+            --line.end;
+
+        if (not function(line))
+            return;
+
+        position = next;
+    }
+}
+
 IReader::IReader(Readable_file file)
-    : m_file{file.m_filename}
+    : m_filename{file.m_filename}, m_file{file.m_filename}
 {
 }
 
 IReader::~IReader() {}
 
+std::vector<std::vector<double>> IReader::get_file_as_vectors()
+{
+    std::vector<std::vector<double>> output;
+    read_into(output);
+    return output;
+}
+
+void IReader::read_fields(std::vector<Lattice_field<double>>& output, Lattice_field<double>::Pages pages)
+{
+    std::vector<std::vector<double>> components;
+    read_into(components);
+
+    output.clear();
+
+    for (const std::vector<double>& component : components)
+    {
+        output.emplace_back(file_lattice, pages);
+        std::copy(component.begin(), component.begin() + std::min(component.size(), output.back().size()), output.back().begin());
+    }
+}
+
+void IReader::read_through_cache(std::vector<std::vector<double>>& output)
+{
+    if (not configuration.sidecar_cache)
+        return read_into(output);
+
+    if (Sidecar::load(m_filename, file_lattice, m_headers, output))
+        return;
+
+    read_into(output);
+
+    if (not Sidecar::save(m_filename, file_lattice, m_headers, output))
+        std::cerr << "Could not write sidecar cache " << Sidecar::filename(m_filename) << "." << std::endl;
+}
+
+std::unique_ptr<const Sidecar::Mapping> IReader::map_through_cache(std::vector<std::vector<double>>& output)
+{
+    if (not configuration.sidecar_cache)
+    {
+        read_into(output);
+        return nullptr;
+    }
+
+    std::unique_ptr<const Sidecar::Mapping> mapping(new Sidecar::Mapping(m_filename));
+
+    if (not mapping->valid())
+    {
+        read_into(output);
+
+        if (not Sidecar::save(m_filename, file_lattice, m_headers, output))
+        {
+            std::cerr << "Could not write sidecar cache " << Sidecar::filename(m_filename) << "." << std::endl;
+            return nullptr;
+        }
+
+        mapping.reset(new Sidecar::Mapping(m_filename));
+
+        //The source changed while it was parsed, output holds what was read
+        if (not mapping->valid())
+            return nullptr;
+
+        output.clear();
+    }
+
+    file_lattice = mapping->lattice();
+    m_headers = mapping->names();
+
+    return mapping;
+}
+
+void IReader::read_positions(const std::vector<size_t>& positions, std::vector<std::vector<double>>& output, const Selection_reader& read)
+{
+    const std::vector<std::string> names = component_names();
+
+    for (size_t position : positions)
+        if (position >= names.size())
+        {
+            std::cerr << "Component " << position << " is out of range, the file has " << names.size() << "." << std::endl;
+            throw ERROR_FILE_FORMAT;
+        }
+
+    std::vector<size_t> selected = positions;
+    std::sort(selected.begin(), selected.end());
+    selected.erase(std::unique(selected.begin(), selected.end()), selected.end());
+
+    output.resize(positions.size());
+
+    //Each component is read once, into the first place it is asked for
+    std::vector<std::vector<double>*> destinations;
+    for (size_t position : selected)
+        destinations.push_back(&output[std::find(positions.begin(), positions.end(), position) - positions.begin()]);
+
+    read(selected, destinations);
+
+    m_headers.clear();
+
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        const size_t first = std::find(positions.begin(), positions.end(), positions[i]) - positions.begin();
+
+        if (first != i)
+            output[i] = output[first];
+
+        m_headers.push_back(names[positions[i]]);
+    }
+}
+
+std::vector<size_t> IReader::positions_of(const std::vector<std::string>& names)
+{
+    const std::vector<std::string> file_names = component_names();
+    std::vector<size_t> positions;
+
+    for (const std::string& name : names)
+    {
+        auto found = std::find(file_names.begin(), file_names.end(), name);
+
+        if (found == file_names.end())
+        {
+            std::cerr << "Component " << name << " not found." << std::endl;
+            throw ERROR_FILE_FORMAT;
+        }
+
+        positions.push_back(found - file_names.begin());
+    }
+
+    return positions;
+}
+
+void IReader::read_components(const std::vector<size_t>& positions, std::vector<std::vector<double>>& output)
+{
+    read_positions(positions, output, [this] (const std::vector<size_t>& selected, const std::vector<std::vector<double>*>& destinations) {
+        read_selected(selected, destinations);
+    });
+}
+
+void IReader::read_components(const std::vector<std::string>& names, std::vector<std::vector<double>>& output)
+{
+    read_components(positions_of(names), output);
+}
+
+Mapped_file::Source IReader::mapping_source() const noexcept
+{
+    return configuration.read_mode == Read_mode::QUEUED ? Mapped_file::Source::QUEUED_READ : Mapped_file::Source::MAP;
+}
+
+Mapped_file::Source IReader::read_ahead_source() const noexcept
+{
+    return configuration.read_mode == Read_mode::QUEUED ? Mapped_file::Source::QUEUED_READ_AHEAD : Mapped_file::Source::MAP;
+}
+
+Lattice_accessor::Range IReader::checked_box(Lattice_accessor::Range box) const
+{
+    const size_t extent[3] = {
+        file_lattice.MX + BOUNDARIES,
+        file_lattice.dimensionality > 1 ? file_lattice.MY + BOUNDARIES : 1,
+        file_lattice.dimensionality > 2 ? file_lattice.MZ + BOUNDARIES : 1
+    };
+
+    size_t* const begin[3] = {&box.x_begin, &box.y_begin, &box.z_begin};
+    size_t* const end[3] = {&box.x_end, &box.y_end, &box.z_end};
+
+    for (size_t d = 0; d < 3; ++d)
+    {
+        if (d >= static_cast<size_t>(file_lattice.dimensionality))
+        {
+            *begin[d] = 0;
+            *end[d] = 1;
+        }
+        else if (*begin[d] >= *end[d] or *end[d] > extent[d])
+        {
+            std::cerr << "Subvolume [" << *begin[d] << ", " << *end[d] << ") in dimension " << d
+                      << " is empty or outside the lattice [0, " << extent[d] << ")." << std::endl;
+            throw ERROR_FILE_FORMAT;
+        }
+    }
+
+    return box;
+}
+
+void IReader::read_subvolume_at(const Lattice_accessor::Range& box, const std::vector<size_t>& positions, Lattice_accessor& subvolume, std::vector<std::vector<double>>& output)
+{
+    //Sets the geometry of the file
+    component_names();
+
+    const Lattice_accessor::Range checked = checked_box(box);
+    const Lattice_accessor cropped = file_lattice.cropped(checked);
+
+    read_positions(positions, output, [this, &checked, &cropped] (const std::vector<size_t>& selected, const std::vector<std::vector<double>*>& destinations) {
+        read_selected_subvolume(selected, checked, cropped, destinations);
+    });
+
+    subvolume = cropped;
+}
+
+void IReader::read_subvolume(const Lattice_accessor::Range& box, Lattice_accessor& subvolume, std::vector<std::vector<double>>& output)
+{
+    std::vector<size_t> positions(component_names().size());
+
+    for (size_t i = 0; i < positions.size(); ++i)
+        positions[i] = i;
+
+    read_subvolume_at(box, positions, subvolume, output);
+}
+
+void IReader::read_subvolume(const Lattice_accessor::Range& box, const std::vector<std::string>& names, Lattice_accessor& subvolume, std::vector<std::vector<double>>& output)
+{
+    read_subvolume_at(box, positions_of(names), subvolume, output);
+}
+
 std::vector<std::string> IReader::tokenize(std::string line, char delimiter)
 {
     std::istringstream stream{line};
@@ -119,8 +456,6 @@ void Pro_reader::read_dimensions(const std::vector<std::string> &header_tokens)
 
 void Pro_reader::check_component_name_format(const std::string &header_token)
 {
-    m_headers.push_back(header_token);
-
     std::vector<std::string> component_tokens = tokenize(header_token, ':');
 
     std::string ERROR = "No headers in the format mol:[molecule]:phi-[monomer].";
@@ -136,6 +471,8 @@ std::vector<std::string> Pro_reader::parse_data(const size_t number_of_component
 
     // Prepare vector of vectors for data
     m_data.resize(number_of_components);
+    for (std::vector<double>& component : m_data)
+        component.clear();
 
     std::vector<std::string> tokens;
     std::string line;
@@ -156,252 +493,2182 @@ std::vector<std::string> Pro_reader::parse_data(const size_t number_of_component
     return tokens;
 }
 
-void Pro_reader::set_lattice_geometry(const std::vector<std::string> &last_line)
+size_t Pro_reader::parse_mapped_rows(const char* position, const char* const end, const size_t number_of_components, const size_t first_component_column, const size_t first_row, const char*& last_line)
 {
-    switch (file_lattice.dimensionality)
-    {
-    case 3:
-        file_lattice.MZ = atof(last_line[Z_DIMENSION].c_str()) + SYSTEM_EDGE_OFFSET;
-    case 2:
-        file_lattice.MY = atof(last_line[Y_DIMENSION].c_str()) + SYSTEM_EDGE_OFFSET;
-    case 1:
-        file_lattice.MX = atof(last_line[X_DIMENSION].c_str()) + SYSTEM_EDGE_OFFSET;
-        break;
-    }
-
-    //We need the correct jump sizes to access the indexed matrix
-    file_lattice.set_jumps();
-}
+    size_t row = first_row;
 
-void Pro_reader::adjust_indexing()
-{
-    std::vector<std::vector<double>> adjusted_data(m_data.size());
+    while (position != end)
+    {
+        //Skip empty lines, including a trailing '\r\n'
+        if (*position == '\n' or *position == '\r')
+        {
+            ++position;
+            continue;
+        }
 
-    for (vector<double> &all_components : adjusted_data)
-        all_components.resize(m_data[0].size());
+        last_line = position;
 
-    size_t n = 0;
-    size_t z = 0;
-    do
-    {
-        size_t y = 0;
-        do
+        for (size_t i = 0; i < first_component_column; ++i)
         {
-            size_t x = 0;
-            do
-            {
-                for (size_t c = 0; c < m_data.size(); ++c)
-                    adjusted_data[c][x * file_lattice.jump_x + y * file_lattice.jump_y + z * file_lattice.jump_z] = m_data[c][n];
-                ++n;
-                ++x;
-            } while (x < file_lattice.MX);
-            ++y;
-        } while (y < file_lattice.MY);
-        ++z;
-    } while (z < file_lattice.MZ);
+            position = Number_parser::skip_field(position, end, '\t');
 
-    m_data = adjusted_data;
-}
+            if (position == end or *position != '\t')
+            {
+                cerr << "Missing columns in row " << row << "." << endl;
+                throw ERROR_FILE_FORMAT;
+            }
 
-Pro_reader::Pro_reader(Readable_file file)
-    : IReader(file), m_data(0)
-{
-}
+            ++position;
+        }
 
-std::vector<std::vector<double>> Pro_reader::get_file_as_vectors()
-{
-    //Find in which column the density profile starts
-    //This depends on the fact that the first mon output is phi
-    std::string header_line;
+        for (size_t i = 0; i < number_of_components; ++i)
+        {
+            if (position >= end)
+            {
+                cerr << "Unexpected end of file in row " << row << "." << endl;
+                throw ERROR_FILE_FORMAT;
+            }
 
-    //Read headers
-    getline(m_file, header_line);
+            const char* number_end = Number_parser::parse_double(position, end, m_data[i][row]);
 
-    check_delimiter(header_line);
+            if (number_end == position)
+            {
+                cerr << "Could not parse number in row " << row << ", component " << i << "." << endl;
+                throw ERROR_FILE_FORMAT;
+            }
 
-    vector<string> headers = tokenize(header_line, '\t');
-    try
-    {
+            position = number_end;
 
-        read_dimensions(headers);
+            if (position != end and *position == '\t')
+                ++position;
+        }
 
-        // First component starts after the dimensionality indicators x, y, or z. Remember, first index = 0.
-        for (size_t i = file_lattice.dimensionality; i < headers.size(); ++i)
-            check_component_name_format(headers[i]);
+        position = Number_parser::next_line(position, end);
+        ++row;
     }
-    catch (std::string ERROR)
-    {
 
-        cerr << ERROR << endl;
-    }
+    return row - first_row;
+}
 
-    size_t number_of_components = headers.size() - file_lattice.dimensionality;
-    size_t first_component_column = IReader::file_lattice.dimensionality;
+std::vector<std::string> Pro_reader::parse_mapped_data(const size_t number_of_components, const size_t first_component_column)
+{
+    //Header has already been consumed by the stream, data starts right after it.
+    const size_t data_offset = static_cast<size_t>(m_file.tellg());
 
-    std::vector<std::string> last_line;
+    Mapped_file mapped_file(m_filename, read_ahead_source());
 
-    last_line = parse_data(number_of_components, first_component_column);
+    const char* const begin = mapped_file.begin() + std::min(data_offset, mapped_file.size());
+    const char* const end = mapped_file.end();
 
-    set_lattice_geometry(last_line);
+    Thread_pool pool(configuration.threads);
 
-    // Because .pro files are written in x-y-z order, whereas namics uses z-y-x for 3D
-    adjust_indexing();
+    //Lines are counted as the file comes in, parsing starts once all of it is there
+    std::vector<Text_range> chunks(line_parts(mapped_file, begin, end, pool.size()));
+    std::vector<size_t> first_rows(chunks.size());
+    std::vector<size_t> parsed_rows(chunks.size());
+    std::vector<const char*> last_lines(chunks.size(), nullptr);
 
-    return m_data;
-}
+    pool.parallel_for(chunks.size(), [&mapped_file, &chunks, &first_rows, begin, end] (size_t chunk) {
+        chunks[chunk] = line_part(mapped_file, begin, end, chunks.size(), chunk);
+        first_rows[chunk] = Number_parser::count_lines(chunks[chunk].first, chunks[chunk].second);
+    });
 
-void Vtk_structured_grid_reader::set_lattice_geometry(const std::vector<std::string> &tokens)
-{
-    switch (file_lattice.dimensionality)
+    //Every chunk writes its rows straight into its own part of the component vectors
+    size_t rows = 0;
+    for (size_t& first_row : first_rows)
     {
-    case 3:
-        file_lattice.MZ = atof(tokens[OFFSET_VTK_DIMENSIONS_TAG + Z_DIMENSION].c_str()) + BOUNDARIES;
-    case 2:
-        file_lattice.MY = atof(tokens[OFFSET_VTK_DIMENSIONS_TAG + Y_DIMENSION].c_str()) + BOUNDARIES;
-    case 1:
-        file_lattice.MX = atof(tokens[OFFSET_VTK_DIMENSIONS_TAG + X_DIMENSION].c_str()) + BOUNDARIES;
-        break;
+        size_t chunk_rows = first_row;
+        first_row = rows;
+        rows += chunk_rows;
     }
-}
 
-Vtk_structured_grid_reader::STATUS Vtk_structured_grid_reader::parse_next_data_block(std::vector<double> &data)
-{
-    std::string line;
+    m_data.resize(number_of_components);
+    for (std::vector<double>& component : m_data)
+        component.resize(rows);
+
+    pool.parallel_for(chunks.size(), [&] (size_t chunk) {
+        parsed_rows[chunk] = parse_mapped_rows(chunks[chunk].first, chunks[chunk].second,
+            number_of_components, first_component_column, first_rows[chunk], last_lines[chunk]);
+    });
 
-    //This should doublely be regex'ed to include possible whitespace
-    while (line.find("LOOKUP_TABLE default") == string::npos)
+    //Row counts include blank lines, which we skipped. Close the gaps, in order.
+    size_t row = 0;
+    const char* last_line = nullptr;
+
+    for (size_t chunk = 0; chunk < chunks.size(); ++chunk)
     {
-        getline(m_file, line);
+        if (row != first_rows[chunk])
+            for (std::vector<double>& component : m_data)
+                memmove(component.data() + row, component.data() + first_rows[chunk], parsed_rows[chunk] * sizeof(double));
+
+        row += parsed_rows[chunk];
+
+        if (last_lines[chunk])
+            last_line = last_lines[chunk];
     }
 
-    while (getline(m_file, line))
+    for (std::vector<double>& component : m_data)
+        component.resize(row);
+
+    if (not last_line)
     {
-        if (!std::regex_match(line, std::regex(R"(^[\d]+.[\d]+(e-?[\d]+)?$)")))
-            return STATUS::NEW_BLOCK_FOUND;
-        else
-            data.emplace_back(atof(line.c_str()));
+        cerr << "No data found in file." << endl;
+        throw ERROR_FILE_FORMAT;
     }
 
-    return STATUS::END;
+    //Only the coordinates of the last line are needed for the lattice geometry.
+    return tokenize(std::string(last_line, Number_parser::next_line(last_line, end) - last_line), '\t');
 }
 
-std::vector<double> Vtk_structured_grid_reader::with_bounds(std::vector<double> &input)
+size_t Pro_reader::parse_mapped_rows_in_place(const char* position, const char* const end, const std::vector<size_t>& columns, const std::vector<double*>& components, const Placement& placement)
 {
-    size_t M_bounds = (file_lattice.MX) * (file_lattice.MY) * (file_lattice.MZ);
-    vector<double> output(M_bounds);
+    const Lattice_accessor::Range& box = placement.box;
 
-    size_t n = 0;
-    size_t z = SYSTEM_EDGE_OFFSET;
-    do
+    const size_t first_component_column = file_lattice.dimensionality;
+
+    const size_t extent[3] = {
+        file_lattice.MX + BOUNDARIES,
+        file_lattice.dimensionality > 1 ? file_lattice.MY + BOUNDARIES : 1,
+        file_lattice.dimensionality > 2 ? file_lattice.MZ + BOUNDARIES : 1
+    };
+
+    size_t rows = 0;
+
+    while (position != end)
     {
-        size_t y = SYSTEM_EDGE_OFFSET;
-        do
+        if (*position == '\n' or *position == '\r')
+        {
+            ++position;
+            continue;
+        }
+
+        size_t coordinate[3] = {0, 0, 0};
+
+        for (size_t i = 0; i < first_component_column; ++i)
         {
-            size_t x = SYSTEM_EDGE_OFFSET;
-            do
+            double value = 0;
+            const char* number_end = Number_parser::parse_double(position, end, value);
+
+            if (number_end == position or number_end == end or *number_end != '\t' or value < 0 or value >= extent[i])
             {
-                output[x * file_lattice.jump_x + y * file_lattice.jump_y + z * file_lattice.jump_z] = input[n];
-                ++n;
-                ++x;
-            } while (x < file_lattice.MX - SYSTEM_EDGE_OFFSET);
-            ++y;
-        } while (y < file_lattice.MY - SYSTEM_EDGE_OFFSET);
-        ++z;
-    } while (z < file_lattice.MZ - SYSTEM_EDGE_OFFSET);
+                cerr << "Invalid coordinates in row " << rows << "." << endl;
+                throw ERROR_FILE_FORMAT;
+            }
 
-    return output;
-}
+            coordinate[i] = static_cast<size_t>(value);
+            position = number_end + 1;
+        }
 
-Vtk_structured_grid_reader::Vtk_structured_grid_reader(Readable_file file)
-    : IReader(file)
-{
-}
+        if (coordinate[0] < box.x_begin or coordinate[0] >= box.x_end
+            or coordinate[1] < box.y_begin or coordinate[1] >= box.y_end
+            or coordinate[2] < box.z_begin or coordinate[2] >= box.z_end)
+        {
+            position = Number_parser::next_line(position, end);
+            continue;
+        }
 
-std::vector<std::vector<double>> Vtk_structured_grid_reader::get_file_as_vectors()
-{
-    std::string header_line;
+        const size_t index = placement.destination->index(
+            coordinate[0] - box.x_begin + placement.origin,
+            coordinate[1] - box.y_begin + placement.origin,
+            coordinate[2] - box.z_begin + placement.origin);
 
-    // Find headers with dimension information
-    while (header_line.find("dimensionality") ==std::string::npos)
-    {
-        getline(m_file, header_line);
-    }
+        size_t column = 0;
 
-    std::vector<std::string> headers;
-    headers = tokenize(header_line, ' ');
+        for (size_t i = 0; i < components.size(); ++i)
+        {
+            for (; column < columns[i]; ++column)
+            {
+                position = Number_parser::skip_field(position, end, '\t');
 
-    if (headers.size() < OFFSET_VTK_DIMENSIONS_TAG+X_DIMENSION+1
-        or headers.size() > OFFSET_VTK_DIMENSIONS_TAG+Z_DIMENSION+1)
-            throw ERROR_FILE_FORMAT;
-    else
-        file_lattice.dimensionality = static_cast<Dimensionality>(headers.size() - OFFSET_VTK_DIMENSIONS_TAG);
+                if (position == end or *position != '\t')
+                {
+                    cerr << "Missing columns in row " << rows << "." << endl;
+                    throw ERROR_FILE_FORMAT;
+                }
 
-    //jump_x, jump_y, jump_z, needed for the with_bounds function.
-    set_lattice_geometry(headers);
+                ++position;
+            }
 
-    std::vector<std::vector<double>> output(0);
+            const char* number_end = Number_parser::parse_double(position, end, components[i][index]);
 
-    std::vector<double> data;
+            if (number_end == position)
+            {
+                cerr << "Could not parse number in row " << rows << ", component " << column << "." << endl;
+                throw ERROR_FILE_FORMAT;
+            }
 
-    Vtk_structured_grid_reader::STATUS status = STATUS::NEW_BLOCK_FOUND;
+            position = number_end;
+            ++column;
 
-    while (status == STATUS::NEW_BLOCK_FOUND)
-    {
-        status = parse_next_data_block(data);
-        //ASSUMPTION: VTK files a written without bounds, so add them
-        data = with_bounds(data);
-        output.emplace_back(data);
-        data.clear();
-    }
+            if (position != end and *position == '\t')
+                ++position;
+        }
 
-    if (status != STATUS::END)
-    {
-        std::cerr << "No blocks found in file" << std::endl;
-        throw ERROR_FILE_FORMAT;
+        position = Number_parser::next_line(position, end);
+        ++rows;
     }
 
-    return output;
+    return rows;
 }
 
-Reader::Reader()
-    : m_read_objects(0)
+void Pro_reader::map_rows()
 {
-    m_file.precision(20);
-}
+    //Header has already been consumed by the stream, data starts right after it.
+    const size_t data_offset = static_cast<size_t>(m_file.tellg());
 
-//Callable for multiple files. returns number of objects read.
-size_t Reader::read_objects_in(Readable_file file)
+    m_mapped_file.reset(new Mapped_file(m_filename, read_ahead_source()));
+
+    const char* const begin = m_mapped_file->begin() + std::min(data_offset, m_mapped_file->size());
+    const char* const end = m_mapped_file->end();
+
+    m_rows = {begin, end};
+
+    //Only the end of the file may be in memory yet
+    const Mapped_file& file = *m_mapped_file;
+    auto before = [&file] (const char* position) {
+        file.wait_for(position - 1, position);
+        return position[-1];
+    };
+
+    //The last line holds the upper coordinates, which fix the lattice before anything is parsed
+    const char* last_line = end;
+    while (last_line != begin and (before(last_line) == '\n' or before(last_line) == '\r'))
+        --last_line;
+
+    const char* const last_line_end = last_line;
+
+    while (last_line != begin and before(last_line) != '\n')
+        --last_line;
+
+    if (last_line == last_line_end)
+    {
+        cerr << "No data found in file." << endl;
+        throw ERROR_FILE_FORMAT;
+    }
+
+    set_lattice_geometry(tokenize(std::string(last_line, last_line_end), '\t'));
+}
+
+//Values per component, fewer than system_size for 1D and 2D lattices
+size_t Pro_reader::rows_in_file() const
+{
+    return (file_lattice.MX + BOUNDARIES)
+        * (file_lattice.dimensionality > 1 ? file_lattice.MY + BOUNDARIES : 1)
+        * (file_lattice.dimensionality > 2 ? file_lattice.MZ + BOUNDARIES : 1);
+}
+
+void Pro_reader::parse_mapped_components_in_place(const std::vector<size_t>& columns, const std::vector<double*>& components)
+{
+    parse_mapped_components_in_place(m_rows, columns, components, {checked_box(file_lattice.plus_bounds()), &file_lattice, 0});
+}
+
+void Pro_reader::parse_mapped_components_in_place(const Text_range& mapped_rows, const std::vector<size_t>& columns, const std::vector<double*>& components, const Placement& placement)
+{
+    const Lattice_accessor::Range& box = placement.box;
+    const size_t rows = (box.x_end - box.x_begin) * (box.y_end - box.y_begin) * (box.z_end - box.z_begin);
+
+    Thread_pool pool(configuration.threads);
+
+    //Parts are parsed as they come in while the file is being read ahead
+    std::vector<size_t> parsed_rows(line_parts(*m_mapped_file, mapped_rows.first, mapped_rows.second, pool.size()));
+
+    pool.parallel_for(parsed_rows.size(), [&] (size_t chunk) {
+        const Text_range part = line_part(*m_mapped_file, mapped_rows.first, mapped_rows.second, parsed_rows.size(), chunk);
+        parsed_rows[chunk] = parse_mapped_rows_in_place(part.first, part.second, columns, components, placement);
+    });
+
+    size_t parsed = 0;
+    for (size_t chunk_rows : parsed_rows)
+        parsed += chunk_rows;
+
+    if (parsed != rows)
+    {
+        cerr << "Number of rows doesn't match the coordinates of the last row." << endl;
+        throw ERROR_FILE_FORMAT;
+    }
+}
+
+//Rows come sorted on the slowest coordinate, so a slab starts where the first row of its lowest plane does.
+//Only the rows around the bisection points are looked at.
+const char* Pro_reader::first_row_from(size_t coordinate) const
+{
+    const size_t column = file_lattice.dimensionality - 1;
+    const char* const end = m_rows.second;
+
+    //Bisection jumps all over the rows
+    m_mapped_file->wait_for(m_rows.first, end);
+
+    //Slowest coordinate of the first row starting at or after line
+    auto key = [column, end] (const char* line) {
+        while (line != end and (*line == '\n' or *line == '\r'))
+            ++line;
+
+        if (line == end)
+            return std::numeric_limits<double>::infinity();
+
+        for (size_t i = 0; i < column; ++i)
+        {
+            line = Number_parser::skip_field(line, end, '\t');
+            if (line != end)
+                ++line;
+        }
+
+        double value = 0;
+        Number_parser::parse_double(line, end, value);
+
+        return value;
+    };
+
+    //Both ends are starts of lines (or the end), the answer lies in [low, high]
+    const char* low = m_rows.first;
+    const char* high = end;
+
+    while (low < high)
+    {
+        const char* const middle = low + (high - low) / 2;
+        const char* const line = middle == low ? low : Number_parser::next_line(middle - 1, high);
+
+        if (line == high)
+        {
+            if (key(low) >= coordinate)
+                high = low;
+            else
+                low = Number_parser::next_line(low, high);
+        }
+        else if (key(line) >= coordinate)
+            high = line;
+        else
+            low = Number_parser::next_line(line, high);
+    }
+
+    return low;
+}
+
+void Pro_reader::set_lattice_geometry(const std::vector<std::string> &last_line)
+{
+    //.pro files include bounds, the last line holds the coordinates of the upper boundary: M + 1
+    switch (file_lattice.dimensionality)
+    {
+    case 3:
+        file_lattice.MZ = atof(last_line[Z_DIMENSION].c_str()) + SYSTEM_EDGE_OFFSET - BOUNDARIES;
+    case 2:
+        file_lattice.MY = atof(last_line[Y_DIMENSION].c_str()) + SYSTEM_EDGE_OFFSET - BOUNDARIES;
+    case 1:
+        file_lattice.MX = atof(last_line[X_DIMENSION].c_str()) + SYSTEM_EDGE_OFFSET - BOUNDARIES;
+        break;
+    }
+
+    //We need the correct jump sizes to access the indexed matrix
+    file_lattice.set_jumps();
+}
+
+//destination[c * destination_stride + r] = source[r * source_stride + c], in tiles that stay in cache
+static void transpose(const double* source, const size_t source_stride, double* destination, const size_t destination_stride, const size_t rows, const size_t columns)
+{
+    for (size_t row_block = 0; row_block < rows; row_block += TRANSPOSE_BLOCK)
+        for (size_t column_block = 0; column_block < columns; column_block += TRANSPOSE_BLOCK)
+        {
+            const size_t row_end = std::min(rows, row_block + TRANSPOSE_BLOCK);
+            const size_t column_end = std::min(columns, column_block + TRANSPOSE_BLOCK);
+
+            for (size_t column = column_block; column < column_end; ++column)
+                for (size_t row = row_block; row < row_end; ++row)
+                    destination[column * destination_stride + row] = source[row * source_stride + column];
+        }
+}
+
+void Pro_reader::adjust_indexing()
+{
+    //File order is n = x + X*(y + Y*z), lattice order x*Y*Z + y*Z + z: x and z swap places.
+    //In 3D every y plane is a Z by X transpose, in 2D the whole file is a Y by X transpose.
+    const size_t x_extent = file_lattice.MX + BOUNDARIES;
+    const size_t y_extent = file_lattice.dimensionality > 1 ? file_lattice.MY + BOUNDARIES : 1;
+    const size_t z_extent = file_lattice.dimensionality > 2 ? file_lattice.MZ + BOUNDARIES : 1;
+
+    if (file_lattice.dimensionality == 1)
+        return;
+
+    Thread_pool pool(configuration.threads);
+
+    for (std::vector<double>& component : m_data)
+    {
+        if (component.size() != x_extent * y_extent * z_extent)
+        {
+            cerr << "Number of rows doesn't match the coordinates of the last row." << endl;
+            throw ERROR_FILE_FORMAT;
+        }
+
+        //One component at a time keeps peak memory at the data plus a single component
+        std::vector<double> adjusted(component.size());
+
+        if (file_lattice.dimensionality == 2)
+        {
+            pool.parallel_for((y_extent + TRANSPOSE_BLOCK - 1) / TRANSPOSE_BLOCK, [&] (size_t block) {
+                const size_t first_y = block * TRANSPOSE_BLOCK;
+                transpose(component.data() + first_y * x_extent, x_extent, adjusted.data() + first_y, y_extent,
+                    std::min(TRANSPOSE_BLOCK, y_extent - first_y), x_extent);
+            });
+        }
+        else
+        {
+            pool.parallel_for(y_extent, [&] (size_t y) {
+                transpose(component.data() + y * x_extent, x_extent * y_extent, adjusted.data() + y * z_extent, y_extent * z_extent,
+                    z_extent, x_extent);
+            });
+        }
+
+        component.swap(adjusted);
+    }
+}
+
+Pro_reader::Pro_reader(Readable_file file)
+    : IReader(file), m_data(0), m_rows{nullptr, nullptr}, m_header_read{false}, m_number_of_components{0}, m_streamed{0}
+{
+}
+
+size_t Pro_reader::read_header()
+{
+    if (m_header_read)
+        return m_number_of_components;
+
+    //Find in which column the density profile starts
+    //This depends on the fact that the first mon output is phi
+    std::string header_line;
+
+    //Read headers
+    getline(m_file, header_line);
+
+    check_delimiter(header_line);
+
+    vector<string> headers = tokenize(header_line, '\t');
+    try
+    {
+
+        read_dimensions(headers);
+
+        // First component starts after the dimensionality indicators x, y, or z. Remember, first index = 0.
+        for (size_t i = file_lattice.dimensionality; i < headers.size(); ++i)
+            check_component_name_format(headers[i]);
+    }
+    catch (std::string ERROR)
+    {
+
+        cerr << ERROR << endl;
+    }
+
+    //Every column gets its name, also when the format check above gave up at the first odd one
+    m_headers.assign(headers.begin() + file_lattice.dimensionality, headers.end());
+
+    m_header_read = true;
+    m_number_of_components = headers.size() - file_lattice.dimensionality;
+
+    return m_number_of_components;
+}
+
+void Pro_reader::read_into(std::vector<std::vector<double>>& output)
+{
+    //Parse into the caller's vectors, reusing whatever they hold
+    m_data.swap(output);
+
+    size_t number_of_components = read_header();
+    size_t first_component_column = IReader::file_lattice.dimensionality;
+
+    const bool mapped = configuration.read_mode != Read_mode::STREAM or configuration.threads > 1;
+
+    if (mapped and configuration.reorder_while_parsing)
+    {
+        map_rows();
+
+        std::vector<size_t> columns;
+        std::vector<double*> components;
+
+        m_data.resize(number_of_components);
+        for (std::vector<double>& component : m_data)
+        {
+            component.resize(rows_in_file());
+            columns.push_back(columns.size());
+            components.push_back(component.data());
+        }
+
+        parse_mapped_components_in_place(columns, components);
+        m_mapped_file.reset();
+
+        m_data.swap(output);
+        return;
+    }
+
+    std::vector<std::string> last_line;
+
+    if (mapped)
+        last_line = parse_mapped_data(number_of_components, first_component_column);
+    else
+        last_line = parse_data(number_of_components, first_component_column);
+
+    set_lattice_geometry(last_line);
+
+    // Because .pro files are written in x-y-z order, whereas namics uses z-y-x for 3D
+    adjust_indexing();
+
+    m_data.swap(output);
+}
+
+void Pro_reader::read_fields(std::vector<Lattice_field<double>>& output, Lattice_field<double>::Pages pages)
+{
+    if (configuration.read_mode == Read_mode::STREAM and configuration.threads == 1)
+        return IReader::read_fields(output, pages);
+
+    const size_t number_of_components = read_header();
+
+    map_rows();
+
+    std::vector<size_t> columns;
+    std::vector<double*> components;
+
+    output.clear();
+
+    for (size_t i = 0; i < number_of_components; ++i)
+    {
+        output.emplace_back(file_lattice, pages);
+        columns.push_back(i);
+        components.push_back(output.back().data());
+    }
+
+    parse_mapped_components_in_place(columns, components);
+    m_mapped_file.reset();
+}
+
+void Pro_reader::open_rows()
+{
+    read_header();
+
+    if (not m_mapped_file)
+        map_rows();
+}
+
+//Every component is a column, so every call parses that column of all rows of the mapped file
+bool Pro_reader::next_component(std::vector<double>& component)
+{
+    open_rows();
+
+    if (m_streamed == m_number_of_components)
+        return false;
+
+    component.resize(rows_in_file());
+    parse_mapped_components_in_place({m_streamed}, {component.data()});
+
+    ++m_streamed;
+
+    return true;
+}
+
+std::vector<std::string> Pro_reader::component_names()
+{
+    //Mapping sets the geometry, without touching the rows
+    open_rows();
+
+    return m_headers;
+}
+
+//All selected columns in a single pass over the rows
+void Pro_reader::read_selected(const std::vector<size_t>& positions, const std::vector<std::vector<double>*>& components)
+{
+    open_rows();
+
+    std::vector<double*> destinations;
+
+    for (std::vector<double>* component : components)
+    {
+        component->resize(rows_in_file());
+        destinations.push_back(component->data());
+    }
+
+    parse_mapped_components_in_place(positions, destinations);
+}
+
+//Parses only the rows between the first and last plane of the box along the slowest dimension
+void Pro_reader::read_selected_subvolume(const std::vector<size_t>& positions, const Lattice_accessor::Range& box, const Lattice_accessor& subvolume, const std::vector<std::vector<double>*>& components)
+{
+    open_rows();
+
+    const size_t rows = (subvolume.MX + BOUNDARIES)
+        * (subvolume.dimensionality > 1 ? subvolume.MY + BOUNDARIES : 1)
+        * (subvolume.dimensionality > 2 ? subvolume.MZ + BOUNDARIES : 1);
+
+    std::vector<double*> destinations;
+
+    for (std::vector<double>* component : components)
+    {
+        component->assign(rows, 0.0);
+        destinations.push_back(component->data());
+    }
+
+    const size_t slowest[3][2] = {{box.x_begin, box.x_end}, {box.y_begin, box.y_end}, {box.z_begin, box.z_end}};
+    const size_t dimension = file_lattice.dimensionality - 1;
+
+    const Text_range slab {first_row_from(slowest[dimension][0]), first_row_from(slowest[dimension][1])};
+
+    parse_mapped_components_in_place(slab, positions, destinations, {box, &subvolume, SYSTEM_EDGE_OFFSET});
+}
+
+void Vtk_structured_grid_reader::set_lattice_geometry(const std::vector<std::string> &tokens)
+{
+    //VTK files are written without bounds, M is stored without bounds just like namics does.
+    switch (file_lattice.dimensionality)
+    {
+    case 3:
+        file_lattice.MZ = atof(tokens[OFFSET_VTK_DIMENSIONS_TAG + Z_DIMENSION].c_str());
+    case 2:
+        file_lattice.MY = atof(tokens[OFFSET_VTK_DIMENSIONS_TAG + Y_DIMENSION].c_str());
+    case 1:
+        file_lattice.MX = atof(tokens[OFFSET_VTK_DIMENSIONS_TAG + X_DIMENSION].c_str());
+        break;
+    }
+
+    file_lattice.set_jumps();
+}
+
+Vtk_structured_grid_reader::Block_cursor::Block_cursor(const Lattice_accessor& lattice, std::vector<double>& output)
+    : m_lattice{&lattice},
+      m_y_first{lattice.dimensionality > 1 ? SYSTEM_EDGE_OFFSET : 0u},
+      m_y_last{lattice.dimensionality > 1 ? lattice.MY + SYSTEM_EDGE_OFFSET : 1},
+      m_z_last{lattice.dimensionality > 2 ? lattice.MZ + SYSTEM_EDGE_OFFSET : 1}
+{
+    output.assign(lattice.system_size, 0.0);
+
+    m_output = output.data();
+    seek(0);
+}
+
+Vtk_structured_grid_reader::Block_cursor::Block_cursor(const Lattice_accessor& lattice, double* output, size_t first)
+    : m_lattice{&lattice},
+      m_output{output},
+      m_y_first{lattice.dimensionality > 1 ? SYSTEM_EDGE_OFFSET : 0u},
+      m_y_last{lattice.dimensionality > 1 ? lattice.MY + SYSTEM_EDGE_OFFSET : 1},
+      m_z_last{lattice.dimensionality > 2 ? lattice.MZ + SYSTEM_EDGE_OFFSET : 1}
+{
+    seek(first);
+}
+
+void Vtk_structured_grid_reader::Block_cursor::seek(size_t first)
+{
+    const size_t x_extent = m_lattice->MX;
+    const size_t y_extent = m_y_last - m_y_first;
+    const size_t rows = first / x_extent;
+
+    m_x = SYSTEM_EDGE_OFFSET + first % x_extent;
+    m_y = m_y_first + rows % y_extent;
+    m_z = (m_lattice->dimensionality > 2 ? SYSTEM_EDGE_OFFSET : 0) + rows / y_extent;
+    m_index = m_lattice->index(m_x, m_y, m_z);
+}
+
+bool Vtk_structured_grid_reader::Block_cursor::place(const double* values, size_t count)
+{
+    const size_t x_last = m_lattice->MX + SYSTEM_EDGE_OFFSET;
+    const size_t jump_x = m_lattice->jump_x;
+
+    while (count > 0)
+    {
+        if (complete())
+            return false;
+
+        //Values along x are jump_x apart, bounds are skipped at the end of every row
+        const size_t run = std::min(count, x_last - m_x);
+        double* destination = m_output + m_index;
+
+        for (size_t i = 0; i < run; ++i)
+            destination[i * jump_x] = values[i];
+
+        values += run;
+        count -= run;
+        m_x += run;
+        m_index += run * jump_x;
+
+        if (m_x == x_last)
+        {
+            m_x = SYSTEM_EDGE_OFFSET;
+
+            if (++m_y == m_y_last)
+            {
+                m_y = m_y_first;
+                ++m_z;
+            }
+
+            m_index = m_lattice->index(m_x, m_y, m_z);
+        }
+    }
+
+    return true;
+}
+
+bool Vtk_structured_grid_reader::Block_cursor::complete() const
+{
+    return m_z == m_z_last;
+}
+
+Vtk_structured_grid_reader::Line_type Vtk_structured_grid_reader::classify_line(const Line_scanner::Line& line)
+{
+    const char* position = line.begin;
+
+    while (position != line.end and *position == ' ')
+        ++position;
+
+    if (position == line.end)
+        return Line_type::EMPTY;
+
+    //Fast exit for the overwhelming majority of lines
+    if (Number_parser::is_digit(*position) or *position == '-' or *position == '+' or *position == '.')
+        return Line_type::NUMBERS;
+
+    if (line.starts_with(VTK_SCALARS_TAG))
+        return Line_type::SCALARS;
+
+    if (line.starts_with(VTK_LOOKUP_TABLE_TAG))
+        return Line_type::LOOKUP_TABLE;
+
+    if (line.starts_with(VTK_DIMENSIONS_TAG)
+        or std::search(line.begin, line.end, VTK_DIMENSIONALITY_TAG, VTK_DIMENSIONALITY_TAG + strlen(VTK_DIMENSIONALITY_TAG)) != line.end)
+            return Line_type::DIMENSIONS;
+
+    if (std::isupper(static_cast<unsigned char>(*position)))
+        return Line_type::KEYWORD;
+
+    //nan, inf and the like
+    return Line_type::NUMBERS;
+}
+
+//Legacy VTK allows any number of values per line
+bool Vtk_structured_grid_reader::parse_numbers(const Line_scanner::Line& line, std::vector<double>& data)
+{
+    const char* position = line.begin;
+
+    while (position != line.end and *position == ' ')
+        ++position;
+
+    while (position != line.end)
+    {
+        double value;
+        const char* number_end = Number_parser::parse_double(position, line.end, value);
+
+        if (number_end == position)
+            return false;
+
+        data.emplace_back(value);
+        position = number_end;
+
+        while (position != line.end and *position == ' ')
+            ++position;
+    }
+
+    return true;
+}
+
+//Numbers on a line as parse_numbers splits them, without parsing
+size_t Vtk_structured_grid_reader::count_numbers(const Line_scanner::Line& line)
+{
+    const char* position = line.begin;
+    size_t count = 0;
+
+    while (position != line.end)
+    {
+        while (position != line.end and *position == ' ')
+            ++position;
+
+        if (position == line.end)
+            break;
+
+        ++count;
+
+        while (position != line.end and *position != ' ')
+            ++position;
+    }
+
+    return count;
+}
+
+void Vtk_structured_grid_reader::read_dimensions(const Line_scanner::Line& line)
+{
+    std::vector<std::string> headers = tokenize(std::string(line.begin, line.end), ' ');
+
+    if (headers.size() < OFFSET_VTK_DIMENSIONS_TAG+X_DIMENSION+1
+        or headers.size() > OFFSET_VTK_DIMENSIONS_TAG+Z_DIMENSION+1)
+            throw ERROR_FILE_FORMAT;
+
+    file_lattice.dimensionality = static_cast<Dimensionality>(headers.size() - OFFSET_VTK_DIMENSIONS_TAG);
+
+    //jump_x, jump_y, jump_z, needed to place values with bounds.
+    set_lattice_geometry(headers);
+}
+
+void Vtk_structured_grid_reader::read_header(Line_scanner& scanner)
+{
+    Line_scanner::Line line;
+
+    // Find headers with dimension information
+    while (scanner.next_line(line))
+        if (classify_line(line) == Line_type::DIMENSIONS)
+        {
+            read_dimensions(line);
+            return;
+        }
+
+    std::cerr << "No dimensions found in file" << std::endl;
+    throw ERROR_FILE_FORMAT;
+}
+
+void Vtk_structured_grid_reader::read_component_name(const Line_scanner::Line& scalars_line)
+{
+    //SCALARS [name] [type] ([components])
+    const char* name_begin = scalars_line.begin + strlen(VTK_SCALARS_TAG);
+
+    while (name_begin != scalars_line.end and *name_begin == ' ')
+        ++name_begin;
+
+    const char* name_end = name_begin;
+
+    while (name_end != scalars_line.end and *name_end != ' ')
+        ++name_end;
+
+    m_headers.emplace_back(name_begin, name_end);
+}
+
+Vtk_structured_grid_reader::STATUS Vtk_structured_grid_reader::find_first_block(Line_scanner& scanner)
+{
+    Line_scanner::Line line;
+
+    while (scanner.next_line(line))
+        if (classify_line(line) == Line_type::SCALARS)
+        {
+            read_component_name(line);
+            return STATUS::NEW_BLOCK_FOUND;
+        }
+
+    return STATUS::END;
+}
+
+//Expects the SCALARS line of the block to be consumed, stops right after the SCALARS line of the next block.
+//Values are parsed per line into data and placed in output, with bounds.
+Vtk_structured_grid_reader::STATUS Vtk_structured_grid_reader::parse_next_data_block(Line_scanner& scanner, std::vector<double>& data, std::vector<double>& output)
+{
+    Line_scanner::Line line;
+
+    bool has_lookup_table = false;
+
+    while (scanner.next_line(line))
+        if (classify_line(line) == Line_type::LOOKUP_TABLE)
+        {
+            has_lookup_table = true;
+            break;
+        }
+
+    if (not has_lookup_table)
+    {
+        std::cerr << "No LOOKUP_TABLE found for component " << m_headers.back() << std::endl;
+        return STATUS::ERROR;
+    }
+
+    //ASSUMPTION: VTK files a written without bounds, so add them
+    Block_cursor cursor(file_lattice, output);
+    bool in_block = true;
+    STATUS status = STATUS::END;
+
+    while (status == STATUS::END and scanner.next_line(line))
+    {
+        switch (classify_line(line))
+        {
+        case Line_type::EMPTY:
+            break;
+        case Line_type::SCALARS:
+            status = STATUS::NEW_BLOCK_FOUND;
+            break;
+        case Line_type::NUMBERS:
+            if (not in_block)
+                break;
+
+            data.clear();
+
+            if (not parse_numbers(line, data))
+            {
+                std::cerr << "Could not parse number in component " << m_headers.back() << std::endl;
+                return STATUS::ERROR;
+            }
+
+            if (not cursor.place(data.data(), data.size()))
+            {
+                std::cerr << "Number of values in block doesn't match the dimensions in the header" << std::endl;
+                return STATUS::ERROR;
+            }
+            break;
+        default:
+            //Any other keyword ends the scalar data, skip ahead to the next SCALARS block.
+            in_block = false;
+            break;
+        }
+    }
+
+    if (not cursor.complete())
+    {
+        std::cerr << "Number of values in block doesn't match the dimensions in the header" << std::endl;
+        return STATUS::ERROR;
+    }
+
+    if (status == STATUS::NEW_BLOCK_FOUND)
+        read_component_name(line);
+
+    return status;
+}
+
+/*
+ *  Two passes over newline aligned chunks of the file, a thread per chunk. The first counts the numbers on every line
+ *  and remembers where the keywords were. Stitching the chunks together in order follows exactly the same rules as
+ *  parse_next_data_block and tells which values of a chunk go where. The second pass parses them straight to their
+ *  place, so nothing but the output is allocated, and the result is identical to the serial parser.
+ */
+void Vtk_structured_grid_reader::parse_mapped_blocks(std::vector<std::vector<double>>& output)
+{
+    struct Event {
+        Line_scanner::Line line;
+        Line_type type;
+        //Values in the chunk that precede this line
+        size_t position;
+    };
+
+    //Values first .. last-1 of a chunk are values offset .. of component
+    struct Segment {
+        size_t first;
+        size_t last;
+        size_t component;
+        size_t offset;
+    };
+
+    struct Chunk {
+        size_t values = 0;
+        std::vector<Event> events;
+        std::vector<Segment> segments;
+    };
+
+    Mapped_file mapped_file(m_filename, mapping_source());
+    Thread_pool pool(configuration.threads);
+
+    std::vector<Text_range> ranges = split_at_lines(mapped_file.begin(), mapped_file.end(), pool.size());
+    std::vector<Chunk> chunks(ranges.size());
+
+    pool.parallel_for(ranges.size(), [&ranges, &chunks] (size_t i) {
+        Chunk& chunk = chunks[i];
+
+        for_each_line(ranges[i].first, ranges[i].second, [&chunk] (const Line_scanner::Line& line) {
+            Line_type type = classify_line(line);
+
+            if (type == Line_type::NUMBERS)
+                chunk.values += count_numbers(line);
+            else if (type != Line_type::EMPTY)
+                chunk.events.push_back( {line, type, chunk.values} );
+
+            return true;
+        });
+    });
+
+    enum class State {
+        HEADER,
+        SEARCHING_BLOCK,
+        SEARCHING_LOOKUP_TABLE,
+        IN_BLOCK,
+        SKIPPING
+    } state = State::HEADER;
+
+    size_t components = 0;
+    size_t block_size = 0;
+    //Values assigned to the current component
+    size_t placed = 0;
+
+    auto add_segment = [this, &components, &block_size, &placed] (Chunk& chunk, size_t first, size_t last) {
+        if (first == last)
+            return;
+
+        if (placed + (last - first) > block_size)
+        {
+            std::cerr << "Number of values in block doesn't match the dimensions in the header" << std::endl;
+            throw ERROR_FILE_FORMAT;
+        }
+
+        chunk.segments.push_back( {first, last, components - 1, placed} );
+        placed += last - first;
+    };
+
+    auto next_component = [this, &output, &components, &block_size, &placed] () {
+        if (components > 0 and placed != block_size)
+        {
+            std::cerr << "Number of values in block doesn't match the dimensions in the header" << std::endl;
+            throw ERROR_FILE_FORMAT;
+        }
+
+        if (output.size() == components)
+            output.emplace_back();
+
+        //ASSUMPTION: VTK files a written without bounds, so add them
+        output[components++].assign(file_lattice.system_size, 0.0);
+        block_size = block_values();
+        placed = 0;
+    };
+
+    for (Chunk& chunk : chunks)
+    {
+        size_t consumed = 0;
+
+        for (Event& event : chunk.events)
+        {
+            if (state == State::IN_BLOCK)
+                add_segment(chunk, consumed, event.position);
+            consumed = event.position;
+
+            switch (state)
+            {
+            case State::HEADER:
+                if (event.type == Line_type::DIMENSIONS)
+                {
+                    read_dimensions(event.line);
+                    state = State::SEARCHING_BLOCK;
+                }
+                break;
+            case State::SEARCHING_BLOCK:
+            case State::SKIPPING:
+            case State::IN_BLOCK:
+                if (event.type == Line_type::SCALARS)
+                {
+                    read_component_name(event.line);
+                    next_component();
+                    state = State::SEARCHING_LOOKUP_TABLE;
+                }
+                else if (state == State::IN_BLOCK)
+                    state = State::SKIPPING;
+                break;
+            case State::SEARCHING_LOOKUP_TABLE:
+                if (event.type == Line_type::LOOKUP_TABLE)
+                    state = State::IN_BLOCK;
+                break;
+            }
+        }
+
+        if (state == State::IN_BLOCK)
+            add_segment(chunk, consumed, chunk.values);
+    }
+
+    switch (state)
+    {
+    case State::HEADER:
+        std::cerr << "No dimensions found in file" << std::endl;
+        throw ERROR_FILE_FORMAT;
+    case State::SEARCHING_BLOCK:
+        std::cerr << "No blocks found in file" << std::endl;
+        throw ERROR_FILE_FORMAT;
+    case State::SEARCHING_LOOKUP_TABLE:
+        std::cerr << "No LOOKUP_TABLE found for component " << m_headers.back() << std::endl;
+        throw ERROR_FILE_FORMAT;
+    default:
+        break;
+    }
+
+    if (placed != block_size)
+    {
+        std::cerr << "Number of values in block doesn't match the dimensions in the header" << std::endl;
+        throw ERROR_FILE_FORMAT;
+    }
+
+    output.resize(components);
+
+    pool.parallel_for(ranges.size(), [this, &ranges, &chunks, &output] (size_t i) {
+        const std::vector<Segment>& segments = chunks[i].segments;
+
+        if (segments.empty())
+            return;
+
+        auto segment = segments.begin();
+        Block_cursor cursor(file_lattice, output[segment->component].data(), segment->offset);
+        std::vector<double> data;
+        size_t value = 0;
+
+        for_each_line(ranges[i].first, ranges[i].second, [&] (const Line_scanner::Line& line) {
+            if (classify_line(line) != Line_type::NUMBERS)
+                return true;
+
+            //Segments start and end at keywords, so a line is either entirely in one or not at all
+            if (value < segment->first)
+            {
+                value += count_numbers(line);
+                return true;
+            }
+
+            data.clear();
+
+            //A line that parses to more numbers than it was counted as would run past its segment
+            if (not parse_numbers(line, data) or value + data.size() > segment->last)
+            {
+                std::cerr << "Could not parse number in component " << m_headers[segment->component] << std::endl;
+                throw ERROR_FILE_FORMAT;
+            }
+
+            cursor.place(data.data(), data.size());
+            value += data.size();
+
+            if (value == segment->last and ++segment != segments.end())
+                cursor = Block_cursor(file_lattice, output[segment->component].data(), segment->offset);
+
+            return segment != segments.end();
+        });
+
+        if (segment != segments.end())
+        {
+            std::cerr << "Could not parse number in component " << m_headers[segment->component] << std::endl;
+            throw ERROR_FILE_FORMAT;
+        }
+    });
+}
+
+size_t Vtk_structured_grid_reader::block_values() const
+{
+    return file_lattice.MX * std::max<size_t>(file_lattice.MY, 1) * std::max<size_t>(file_lattice.MZ, 1);
+}
+
+size_t Vtk_structured_grid_reader::binary_type_size(const std::string& type)
+{
+    if (type == "double")
+        return sizeof(double);
+
+    if (type == "float")
+        return sizeof(float);
+
+    std::cerr << "Unsupported binary scalar type " << type << std::endl;
+    throw ERROR_FILE_FORMAT;
+}
+
+void Vtk_structured_grid_reader::read_binary_block(const std::string& type, const std::string& name, std::vector<double>& output)
+{
+    const size_t points = block_values();
+    const size_t type_size = binary_type_size(type);
+
+    //ASSUMPTION: VTK files a written without bounds, so add them
+    Block_cursor cursor(file_lattice, output);
+
+    //Converted a chunk at a time, so only the output is as large as the block
+    const size_t chunk_size = std::min(points, BINARY_CHUNK);
+    std::vector<char> bytes(chunk_size * type_size);
+    std::vector<double> values(chunk_size);
+    std::vector<float> single_precision(type_size == sizeof(float) ? chunk_size : 0);
+
+    for (size_t first = 0; first < points; first += chunk_size)
+    {
+        const size_t count = std::min(chunk_size, points - first);
+
+        m_file.read(bytes.data(), count * type_size);
+
+        if (static_cast<size_t>(m_file.gcount()) != count * type_size)
+        {
+            std::cerr << "Unexpected end of file in component " << name << std::endl;
+            throw ERROR_FILE_FORMAT;
+        }
+
+        if (type_size == sizeof(double))
+        {
+            Byte_order::from_big_endian(bytes.data(), count, values.data());
+        }
+        else
+        {
+            Byte_order::from_big_endian(bytes.data(), count, single_precision.data());
+            std::copy(single_precision.begin(), single_precision.begin() + count, values.begin());
+        }
+
+        cursor.place(values.data(), count);
+    }
+}
+
+//Header lines are text, the data following POINTS and LOOKUP_TABLE is read as one block.
+//Reads up to and including the next block, returns false at the end of the file. Without output the
+//block is only indexed and skipped.
+bool Vtk_structured_grid_reader::next_binary_block(std::vector<double>* output)
+{
+    std::string text;
+
+    while (getline(m_file, text))
+    {
+        if (not text.empty() and text.back() == '\r')
+            text.pop_back();
+
+        Line_scanner::Line line {text.data(), text.data() + text.size()};
+
+        if (++m_line_number == VTK_ENCODING_LINE and not line.starts_with(VTK_BINARY_TAG))
+        {
+            std::cerr << "File is not BINARY encoded" << std::endl;
+            throw ERROR_FILE_FORMAT;
+        }
+
+        switch (classify_line(line))
+        {
+        case Line_type::DIMENSIONS:
+            if (not m_has_dimensions)
+                read_dimensions(line);
+            m_has_dimensions = true;
+            break;
+        case Line_type::KEYWORD:
+            //POINTS [n] [type], skip the coordinates of a structured grid
+            if (line.starts_with(VTK_POINTS_TAG))
+            {
+                std::vector<std::string> tokens = tokenize(text, ' ');
+
+                if (tokens.size() < 3)
+                    throw ERROR_FILE_FORMAT;
+
+                size_t type_size = (tokens[2] == "double") ? sizeof(double) : sizeof(float);
+                m_file.ignore(atol(tokens[1].c_str()) * 3 * type_size);
+            }
+            break;
+        case Line_type::SCALARS:
+        {
+            if (not m_has_dimensions)
+            {
+                std::cerr << "No dimensions found in file" << std::endl;
+                throw ERROR_FILE_FORMAT;
+            }
+
+            read_component_name(line);
+
+            //SCALARS [name] [type]
+            std::vector<std::string> tokens = tokenize(text, ' ');
+
+            if (tokens.size() < 3)
+                throw ERROR_FILE_FORMAT;
+
+            bool has_lookup_table = false;
+
+            while (not has_lookup_table and getline(m_file, text))
+                has_lookup_table = text.compare(0, strlen(VTK_LOOKUP_TABLE_TAG), VTK_LOOKUP_TABLE_TAG) == 0;
+
+            if (not has_lookup_table)
+            {
+                std::cerr << "No LOOKUP_TABLE found for component " << m_headers.back() << std::endl;
+                throw ERROR_FILE_FORMAT;
+            }
+
+            const size_t begin = static_cast<size_t>(m_file.tellg());
+            const size_t bytes = block_values() * binary_type_size(tokens[2]);
+
+            if (not m_indexed)
+                m_blocks.push_back( {m_headers.back(), tokens[2], begin, begin + bytes} );
+
+            if (output)
+                read_binary_block(tokens[2], m_headers.back(), *output);
+            else
+                m_file.seekg(bytes, std::ios::cur);
+
+            ++m_streamed;
+            return true;
+        }
+        default:
+            break;
+        }
+    }
+
+    if (m_streamed == 0)
+    {
+        std::cerr << "No blocks found in file" << std::endl;
+        throw ERROR_FILE_FORMAT;
+    }
+
+    return false;
+}
+
+Vtk_structured_grid_reader::Vtk_structured_grid_reader(Readable_file file)
+    : IReader(file), m_binary{file.get_filetype() == Readable_filetype::VTK_STRUCTURED_GRID_BINARY},
+      m_status{STATUS::END}, m_streamed{0}, m_line_number{0}, m_has_dimensions{false}, m_indexed{false}
+{
+}
+
+const std::vector<Vtk_structured_grid_reader::Block>& Vtk_structured_grid_reader::block_index()
+{
+    if (m_indexed)
+        return m_blocks;
+
+    if (configuration.persist_block_index and load_block_index())
+    {
+        m_indexed = true;
+        return m_blocks;
+    }
+
+    m_blocks.clear();
+
+    if (m_binary)
+    {
+        //Walk the headers, seeking past the data, then start over for whoever reads next
+        m_file.clear();
+        m_file.seekg(0);
+
+        while (next_binary_block(nullptr))
+            ;
+
+        m_file.clear();
+        m_file.seekg(0);
+        m_streamed = 0;
+        m_line_number = 0;
+        m_has_dimensions = false;
+        m_headers.clear();
+    }
+    else
+        index_ascii_blocks();
+
+    m_indexed = true;
+
+    if (configuration.persist_block_index)
+        save_block_index();
+
+    return m_blocks;
+}
+
+//Only keyword lines matter, so this is a scan for line ends, in parallel chunks, plus the same rules as parse_mapped_blocks
+void Vtk_structured_grid_reader::index_ascii_blocks()
+{
+    struct Keyword {
+        Line_scanner::Line line;
+        Line_type type;
+    };
+
+    if (not m_mapped_file)
+        m_mapped_file.reset(new Mapped_file(m_filename, mapping_source()));
+
+    const char* const begin = m_mapped_file->begin();
+    const char* const end = m_mapped_file->end();
+
+    Thread_pool pool(configuration.threads);
+
+    std::vector<Text_range> ranges = split_at_lines(begin, end, pool.size());
+    std::vector<std::vector<Keyword>> keywords(ranges.size());
+
+    pool.parallel_for(ranges.size(), [&ranges, &keywords] (size_t i) {
+        for_each_line(ranges[i].first, ranges[i].second, [&keywords, i] (const Line_scanner::Line& line) {
+            Line_type type = classify_line(line);
+
+            if (type != Line_type::NUMBERS and type != Line_type::EMPTY)
+                keywords[i].push_back( {line, type} );
+
+            return true;
+        });
+    });
+
+    enum class State {
+        HEADER,
+        SEARCHING_BLOCK,
+        SEARCHING_LOOKUP_TABLE,
+        IN_BLOCK,
+        SKIPPING
+    } state = State::HEADER;
+
+    for (const std::vector<Keyword>& chunk : keywords)
+        for (const Keyword& keyword : chunk)
+        {
+            if (state == State::IN_BLOCK)
+                m_blocks.back().end = keyword.line.begin - begin;
+
+            switch (state)
+            {
+            case State::HEADER:
+                if (keyword.type == Line_type::DIMENSIONS)
+                {
+                    read_dimensions(keyword.line);
+                    state = State::SEARCHING_BLOCK;
+                }
+                break;
+            case State::SEARCHING_BLOCK:
+            case State::SKIPPING:
+            case State::IN_BLOCK:
+                if (keyword.type == Line_type::SCALARS)
+                {
+                    //SCALARS [name] [type]
+                    std::vector<std::string> tokens = tokenize(std::string(keyword.line.begin, keyword.line.end), ' ');
+
+                    if (tokens.size() < 3)
+                        throw ERROR_FILE_FORMAT;
+
+                    m_blocks.push_back( {tokens[1], tokens[2], 0, 0} );
+                    state = State::SEARCHING_LOOKUP_TABLE;
+                }
+                else if (state == State::IN_BLOCK)
+                    state = State::SKIPPING;
+                break;
+            case State::SEARCHING_LOOKUP_TABLE:
+                if (keyword.type == Line_type::LOOKUP_TABLE)
+                {
+                    m_blocks.back().begin = Number_parser::next_line(keyword.line.begin, end) - begin;
+                    state = State::IN_BLOCK;
+                }
+                break;
+            }
+        }
+
+    if (state == State::IN_BLOCK)
+        m_blocks.back().end = end - begin;
+
+    switch (state)
+    {
+    case State::HEADER:
+        std::cerr << "No dimensions found in file" << std::endl;
+        throw ERROR_FILE_FORMAT;
+    case State::SEARCHING_BLOCK:
+        std::cerr << "No blocks found in file" << std::endl;
+        throw ERROR_FILE_FORMAT;
+    case State::SEARCHING_LOOKUP_TABLE:
+        std::cerr << "No LOOKUP_TABLE found for component " << m_blocks.back().name << std::endl;
+        throw ERROR_FILE_FORMAT;
+    default:
+        break;
+    }
+}
+
+std::string Vtk_structured_grid_reader::block_index_filename() const
+{
+    return m_filename + VTK_BLOCK_INDEX_EXTENSION;
+}
+
+/*
+ *  Plain text, so scripts can use it too:
+ *      vtk_block_index 1
+ *      source [size] [mtime seconds] [mtime nanoseconds]
+ *      encoding [ASCII or BINARY]
+ *      dimensions [dimensionality] [MX] [MY] [MZ]
+ *      [first byte of values] [first byte after them] [type] [name]     (one line per SCALARS block)
+ */
+void Vtk_structured_grid_reader::save_block_index() const
+{
+    struct stat status;
+
+    if (stat(m_filename.c_str(), &status) == -1)
+        return;
+
+    std::ofstream index(block_index_filename());
+
+    index << VTK_BLOCK_INDEX_TAG << ' ' << VTK_BLOCK_INDEX_VERSION << '\n'
+          << "source " << status.st_size << ' ' << status.st_mtim.tv_sec << ' ' << status.st_mtim.tv_nsec << '\n'
+          << "encoding " << (m_binary ? "BINARY" : "ASCII") << '\n'
+          << "dimensions " << static_cast<int>(file_lattice.dimensionality) << ' '
+              << file_lattice.MX << ' ' << file_lattice.MY << ' ' << file_lattice.MZ << '\n';
+
+    for (const Block& block : m_blocks)
+        index << block.begin << ' ' << block.end << ' ' << block.type << ' ' << block.name << '\n';
+
+    if (not index)
+        std::cerr << "Could not write block index " << block_index_filename() << "." << std::endl;
+}
+
+//False if there is no index, or it was made for another version of the file
+bool Vtk_structured_grid_reader::load_block_index()
+{
+    struct stat status;
+    std::ifstream index(block_index_filename());
+
+    if (not index or stat(m_filename.c_str(), &status) == -1)
+        return false;
+
+    std::string tag, keyword, encoding;
+    int version = 0, dimensionality = 0;
+    long long size = 0, seconds = 0, nanoseconds = 0;
+    Lattice_accessor lattice;
+
+    index >> tag >> version
+          >> keyword >> size >> seconds >> nanoseconds
+          >> keyword >> encoding
+          >> keyword >> dimensionality >> lattice.MX >> lattice.MY >> lattice.MZ;
+
+    if (not index or tag != VTK_BLOCK_INDEX_TAG or version != VTK_BLOCK_INDEX_VERSION
+        or size != status.st_size or seconds != status.st_mtim.tv_sec or nanoseconds != status.st_mtim.tv_nsec
+        or encoding != (m_binary ? "BINARY" : "ASCII") or dimensionality < 1 or dimensionality > 3)
+            return false;
+
+    std::vector<Block> blocks;
+    Block block;
+
+    while (index >> block.begin >> block.end >> block.type >> block.name)
+        blocks.push_back(block);
+
+    if (blocks.empty())
+        return false;
+
+    lattice.dimensionality = static_cast<Dimensionality>(dimensionality);
+    lattice.set_jumps();
+
+    file_lattice = lattice;
+    m_blocks = blocks;
+
+    return true;
+}
+
+std::vector<std::string> Vtk_structured_grid_reader::component_names()
+{
+    std::vector<std::string> names;
+
+    for (const Block& block : block_index())
+        names.push_back(block.name);
+
+    return names;
+}
+
+void Vtk_structured_grid_reader::read_selected(const std::vector<size_t>& positions, const std::vector<std::vector<double>*>& components)
+{
+    const std::vector<Block>& blocks = block_index();
+
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        const Block& block = blocks[positions[i]];
+
+        if (m_binary)
+        {
+            m_file.clear();
+            m_file.seekg(block.begin);
+            read_binary_block(block.type, block.name, *components[i]);
+        }
+        else
+            read_ascii_block(block, *components[i]);
+    }
+}
+
+//Chunks of the block are counted, then parsed straight to their place, in parallel
+void Vtk_structured_grid_reader::read_ascii_block(const Block& block, std::vector<double>& output)
+{
+    if (not m_mapped_file)
+        m_mapped_file.reset(new Mapped_file(m_filename, mapping_source()));
+
+    if (block.begin > block.end or block.end > m_mapped_file->size())
+    {
+        std::cerr << "Block index doesn't match " << m_filename << "." << std::endl;
+        throw ERROR_FILE_FORMAT;
+    }
+
+    Thread_pool pool(configuration.threads);
+
+    std::vector<Text_range> ranges = split_at_lines(m_mapped_file->begin() + block.begin, m_mapped_file->begin() + block.end, pool.size());
+    //Value of the block each chunk starts at, and the end of the block
+    std::vector<size_t> first_values(ranges.size() + 1, 0);
+
+    if (ranges.size() > 1)
+    {
+        pool.parallel_for(ranges.size(), [&ranges, &first_values] (size_t i) {
+            for_each_line(ranges[i].first, ranges[i].second, [&first_values, i] (const Line_scanner::Line& line) {
+                first_values[i + 1] += count_numbers(line);
+                return true;
+            });
+        });
+
+        for (size_t i = 1; i < first_values.size(); ++i)
+            first_values[i] += first_values[i - 1];
+    }
+    else
+        first_values.back() = block_values();
+
+    //ASSUMPTION: VTK files a written without bounds, so add them
+    output.assign(file_lattice.system_size, 0.0);
+
+    std::vector<size_t> placed(ranges.size(), 0);
+
+    pool.parallel_for(ranges.size(), [this, &ranges, &first_values, &placed, &block, &output] (size_t i) {
+        Block_cursor cursor(file_lattice, output.data(), first_values[i]);
+        std::vector<double> data;
+
+        for_each_line(ranges[i].first, ranges[i].second, [&] (const Line_scanner::Line& line) {
+            data.clear();
+
+            if (not parse_numbers(line, data))
+            {
+                std::cerr << "Could not parse number in component " << block.name << std::endl;
+                throw ERROR_FILE_FORMAT;
+            }
+
+            if (placed[i] + data.size() > first_values[i + 1] - first_values[i] or not cursor.place(data.data(), data.size()))
+            {
+                std::cerr << "Number of values in block doesn't match the dimensions in the header" << std::endl;
+                throw ERROR_FILE_FORMAT;
+            }
+
+            placed[i] += data.size();
+            return true;
+        });
+    });
+
+    size_t total = 0;
+    for (size_t i = 0; i < ranges.size(); ++i)
+        total += placed[i];
+
+    if (total != block_values())
+    {
+        std::cerr << "Number of values in block doesn't match the dimensions in the header" << std::endl;
+        throw ERROR_FILE_FORMAT;
+    }
+}
+
+Lattice_accessor::Range Vtk_structured_grid_reader::stored_part(const Lattice_accessor::Range& box) const
+{
+    Lattice_accessor::Range part = box;
+
+    const size_t extent[3] = {file_lattice.MX, file_lattice.MY, file_lattice.MZ};
+    size_t* const begin[3] = {&part.x_begin, &part.y_begin, &part.z_begin};
+    size_t* const end[3] = {&part.x_end, &part.y_end, &part.z_end};
+
+    for (size_t d = 0; d < static_cast<size_t>(file_lattice.dimensionality); ++d)
+    {
+        *begin[d] = std::max<size_t>(*begin[d], SYSTEM_EDGE_OFFSET);
+        *end[d] = std::min<size_t>(*end[d], extent[d] + SYSTEM_EDGE_OFFSET);
+
+        if (*begin[d] >= *end[d])
+        {
+            part.x_end = part.x_begin;
+            break;
+        }
+    }
+
+    return part;
+}
+
+void Vtk_structured_grid_reader::read_binary_subvolume(const Block& block, const Lattice_accessor::Range& box, const Lattice_accessor& subvolume, std::vector<double>& output)
+{
+    const Lattice_accessor::Range part = stored_part(box);
+
+    output.assign(subvolume.system_size, 0.0);
+
+    if (part.x_begin == part.x_end)
+        return;
+
+    const size_t type_size = binary_type_size(block.type);
+    const size_t x_extent = file_lattice.MX;
+    const size_t y_extent = file_lattice.dimensionality > 1 ? file_lattice.MY : 1;
+    const size_t y_first = file_lattice.dimensionality > 1 ? SYSTEM_EDGE_OFFSET : 0;
+    const size_t z_first = file_lattice.dimensionality > 2 ? SYSTEM_EDGE_OFFSET : 0;
+    const size_t row_length = part.x_end - part.x_begin;
+
+    //Whole rows follow each other in the file, so their plane of the box is a single read
+    const size_t rows_per_read = row_length == x_extent ? part.y_end - part.y_begin : 1;
+    const size_t count = rows_per_read * row_length;
+
+    std::vector<char> bytes(count * type_size);
+    std::vector<double> values(count);
+    std::vector<float> single_precision(type_size == sizeof(float) ? count : 0);
+
+    for (size_t z = part.z_begin; z < part.z_end; ++z)
+        for (size_t y = part.y_begin; y < part.y_end; y += rows_per_read)
+        {
+            const size_t first = part.x_begin - SYSTEM_EDGE_OFFSET + x_extent * (y - y_first + y_extent * (z - z_first));
+
+            m_file.clear();
+            m_file.seekg(block.begin + first * type_size);
+            m_file.read(bytes.data(), count * type_size);
+
+            if (static_cast<size_t>(m_file.gcount()) != count * type_size)
+            {
+                std::cerr << "Unexpected end of file in component " << block.name << std::endl;
+                throw ERROR_FILE_FORMAT;
+            }
+
+            if (type_size == sizeof(double))
+            {
+                Byte_order::from_big_endian(bytes.data(), count, values.data());
+            }
+            else
+            {
+                Byte_order::from_big_endian(bytes.data(), count, single_precision.data());
+                std::copy(single_precision.begin(), single_precision.end(), values.begin());
+            }
+
+            for (size_t row = 0; row < rows_per_read; ++row)
+            {
+                double* destination = output.data() + subvolume.index(
+                    part.x_begin - box.x_begin + SYSTEM_EDGE_OFFSET,
+                    y + row - box.y_begin + SYSTEM_EDGE_OFFSET,
+                    z - box.z_begin + SYSTEM_EDGE_OFFSET);
+
+                for (size_t i = 0; i < row_length; ++i)
+                    destination[i * subvolume.jump_x] = values[row * row_length + i];
+            }
+        }
+}
+
+//Lines can't be sought without parsing, but counting their values is enough to skip them.
+//The scan stops after the last value of the box.
+void Vtk_structured_grid_reader::read_ascii_subvolume(const Block& block, const Lattice_accessor::Range& box, const Lattice_accessor& subvolume, std::vector<double>& output)
+{
+    const Lattice_accessor::Range part = stored_part(box);
+
+    output.assign(subvolume.system_size, 0.0);
+
+    if (part.x_begin == part.x_end)
+        return;
+
+    if (not m_mapped_file)
+        m_mapped_file.reset(new Mapped_file(m_filename, mapping_source()));
+
+    if (block.begin > block.end or block.end > m_mapped_file->size())
+    {
+        std::cerr << "Block index doesn't match " << m_filename << "." << std::endl;
+        throw ERROR_FILE_FORMAT;
+    }
+
+    const size_t x_extent = file_lattice.MX;
+    const size_t y_extent = file_lattice.dimensionality > 1 ? file_lattice.MY : 1;
+    const size_t y_first = file_lattice.dimensionality > 1 ? SYSTEM_EDGE_OFFSET : 0;
+    const size_t z_first = file_lattice.dimensionality > 2 ? SYSTEM_EDGE_OFFSET : 0;
+
+    auto value_at = [=] (size_t x, size_t y, size_t z) {
+        return x - SYSTEM_EDGE_OFFSET + x_extent * (y - y_first + y_extent * (z - z_first));
+    };
+
+    //Index in output of the n-th value of the block, or output.size() when it is outside the box
+    auto destination = [&] (size_t n) {
+        const size_t rows = n / x_extent;
+        const size_t x = n - rows * x_extent + SYSTEM_EDGE_OFFSET;
+        const size_t y = rows % y_extent + y_first;
+        const size_t z = rows / y_extent + z_first;
+
+        if (x < part.x_begin or x >= part.x_end or y < part.y_begin or y >= part.y_end or z < part.z_begin or z >= part.z_end)
+            return output.size();
+
+        return subvolume.index(x - box.x_begin + SYSTEM_EDGE_OFFSET, y - box.y_begin + SYSTEM_EDGE_OFFSET, z - box.z_begin + SYSTEM_EDGE_OFFSET);
+    };
+
+    const size_t first_needed = value_at(part.x_begin, part.y_begin, part.z_begin);
+    const size_t last_needed = value_at(part.x_end - 1, part.y_end - 1, part.z_end - 1) + 1;
+
+    size_t value = 0;
+    std::vector<double> data;
+
+    for_each_line(m_mapped_file->begin() + block.begin, m_mapped_file->begin() + block.end, [&] (const Line_scanner::Line& line) {
+        const size_t count = count_numbers(line);
+
+        if (value + count > first_needed)
+        {
+            size_t needed = 0;
+            while (needed < count and destination(value + needed) == output.size())
+                ++needed;
+
+            if (needed < count)
+            {
+                data.clear();
+
+                if (not parse_numbers(line, data))
+                {
+                    std::cerr << "Could not parse number in component " << block.name << std::endl;
+                    throw ERROR_FILE_FORMAT;
+                }
+
+                for (size_t i = needed; i < count; ++i)
+                {
+                    const size_t index = destination(value + i);
+
+                    if (index != output.size())
+                        output[index] = data[i];
+                }
+            }
+        }
+
+        value += count;
+
+        return value < last_needed;
+    });
+
+    if (value < last_needed)
+    {
+        std::cerr << "Number of values in block doesn't match the dimensions in the header" << std::endl;
+        throw ERROR_FILE_FORMAT;
+    }
+}
+
+void Vtk_structured_grid_reader::read_selected_subvolume(const std::vector<size_t>& positions, const Lattice_accessor::Range& box, const Lattice_accessor& subvolume, const std::vector<std::vector<double>*>& components)
+{
+    const std::vector<Block>& blocks = block_index();
+
+    if (m_binary)
+    {
+        for (size_t i = 0; i < positions.size(); ++i)
+            read_binary_subvolume(blocks[positions[i]], box, subvolume, *components[i]);
+
+        return;
+    }
+
+    //Every block is a separate scan of the mapped file, so they run side by side
+    if (not m_mapped_file)
+        m_mapped_file.reset(new Mapped_file(m_filename, mapping_source()));
+
+    Thread_pool pool(configuration.threads);
+
+    pool.parallel_for(positions.size(), [&] (size_t i) {
+        read_ascii_subvolume(blocks[positions[i]], box, subvolume, *components[i]);
+    });
+}
+
+bool Vtk_structured_grid_reader::next_component(std::vector<double>& component)
+{
+    if (m_binary)
+        return next_binary_block(&component);
+
+    if (not m_scanner)
+    {
+        m_scanner.reset(new Line_scanner(m_file));
+
+        read_header(*m_scanner);
+
+        m_status = find_first_block(*m_scanner);
+
+        if (m_status != STATUS::NEW_BLOCK_FOUND)
+        {
+            std::cerr << "No blocks found in file" << std::endl;
+            throw ERROR_FILE_FORMAT;
+        }
+    }
+
+    if (m_status != STATUS::NEW_BLOCK_FOUND)
+        return false;
+
+    m_status = parse_next_data_block(*m_scanner, m_line_values, component);
+
+    if (m_status == STATUS::ERROR)
+        throw ERROR_FILE_FORMAT;
+
+    ++m_streamed;
+
+    return true;
+}
+
+void Vtk_structured_grid_reader::read_into(std::vector<std::vector<double>>& output)
+{
+    if (not m_binary and (configuration.read_mode != Read_mode::STREAM or configuration.threads > 1))
+        return parse_mapped_blocks(output);
+
+    size_t components = 0;
+
+    for (;;)
+    {
+        if (output.size() == components)
+            output.emplace_back();
+
+        if (not next_component(output[components]))
+            break;
+
+        ++components;
+    }
+
+    output.resize(components);
+}
+
+Container_reader::Container_reader(Readable_file file)
+    : IReader(file), m_streamed{0}
+{
+    memset(&m_header, 0, sizeof(m_header));
+}
+
+void Container_reader::set_lattice_geometry(const std::vector<std::string>&)
+{
+    //The geometry is in the header, see open_container
+}
+
+void Container_reader::open_container()
+{
+    using namespace Lattice_container;
+
+    if (m_mapped_file)
+        return;
+
+    m_mapped_file.reset(new Mapped_file(m_filename, mapping_source()));
+
+    const char* const begin = m_mapped_file->begin();
+    const size_t size = m_mapped_file->size();
+
+    if (size < sizeof(Header))
+    {
+        std::cerr << m_filename << " is too short for a lattice container." << std::endl;
+        throw ERROR_FILE_FORMAT;
+    }
+
+    memcpy(&m_header, begin, sizeof(Header));
+
+    if (memcmp(m_header.magic, MAGIC, sizeof(MAGIC)) != 0 or m_header.version != VERSION)
+    {
+        std::cerr << m_filename << " is not a lattice container of version " << VERSION << "." << std::endl;
+        throw ERROR_FILE_FORMAT;
+    }
+
+    if (m_header.byte_order != BYTE_ORDER_MARK)
+    {
+        std::cerr << m_filename << " was written on a machine with another byte order." << std::endl;
+        throw ERROR_FILE_FORMAT;
+    }
+
+    const size_t chunks = m_header.components * m_header.chunks_per_component;
+
+    if (m_header.dimensionality < 1 or m_header.dimensionality > 3
+        or m_header.names_offset + m_header.names_size > size
+        or m_header.index_offset % sizeof(uint64_t) != 0
+        or m_header.index_offset + chunks * sizeof(Chunk) > size)
+    {
+        std::cerr << "Header of " << m_filename << " doesn't match its size." << std::endl;
+        throw ERROR_FILE_FORMAT;
+    }
+
+    file_lattice.dimensionality = static_cast<Dimensionality>(m_header.dimensionality);
+    file_lattice.MX = m_header.MX;
+    file_lattice.MY = m_header.MY;
+    file_lattice.MZ = m_header.MZ;
+    file_lattice.set_jumps();
+
+    const Lattice_accessor::Range stored = stored_range(file_lattice, m_header.with_bounds);
+    const Chunk* const index = reinterpret_cast<const Chunk*>(begin + m_header.index_offset);
+
+    m_chunks.assign(index, index + chunks);
+
+    for (const Chunk& chunk : m_chunks)
+        if (chunk.offset % ALIGNMENT != 0 or chunk.offset + chunk.values * sizeof(double) > size
+            or chunk.x_begin < stored.x_begin or chunk.x_end > stored.x_end or chunk.x_begin >= chunk.x_end
+            or chunk.y_begin < stored.y_begin or chunk.y_end > stored.y_end or chunk.y_begin >= chunk.y_end
+            or chunk.z_begin < stored.z_begin or chunk.z_end > stored.z_end or chunk.z_begin >= chunk.z_end
+            or chunk.values != (chunk.x_end - chunk.x_begin) * (chunk.y_end - chunk.y_begin) * (chunk.z_end - chunk.z_begin))
+        {
+            std::cerr << "Chunk index of " << m_filename << " doesn't match the lattice." << std::endl;
+            throw ERROR_FILE_FORMAT;
+        }
+
+    const char* name = begin + m_header.names_offset;
+    const char* const names_end = name + m_header.names_size;
+
+    while (name != names_end)
+    {
+        const char* const name_end = std::find(name, names_end, '\0');
+
+        m_names.emplace_back(name, name_end);
+        name = name_end == names_end ? names_end : name_end + 1;
+    }
+
+    if (m_names.size() != m_header.components)
+    {
+        std::cerr << "Number of names in " << m_filename << " doesn't match the number of components." << std::endl;
+        throw ERROR_FILE_FORMAT;
+    }
+}
+
+void Container_reader::copy_component(size_t position, const Lattice_accessor::Range& box, size_t origin, const Lattice_accessor& destination, double* output)
+{
+    const Lattice_container::Chunk* chunk = m_chunks.data() + position * m_header.chunks_per_component;
+
+    for (size_t i = 0; i < m_header.chunks_per_component; ++i, ++chunk)
+    {
+        const Lattice_accessor::Range part {
+            std::max<size_t>(box.x_begin, chunk->x_begin), std::min<size_t>(box.x_end, chunk->x_end),
+            std::max<size_t>(box.y_begin, chunk->y_begin), std::min<size_t>(box.y_end, chunk->y_end),
+            std::max<size_t>(box.z_begin, chunk->z_begin), std::min<size_t>(box.z_end, chunk->z_end)
+        };
+
+        if (part.x_begin >= part.x_end or part.y_begin >= part.y_end or part.z_begin >= part.z_end)
+            continue;
+
+        const double* const values = reinterpret_cast<const double*>(m_mapped_file->begin() + chunk->offset);
+        const size_t y_extent = chunk->y_end - chunk->y_begin;
+        const size_t z_extent = chunk->z_end - chunk->z_begin;
+
+        //Runs of the part along the innermost dimension are contiguous in the chunk and in the destination
+        Lattice_container::for_each_run(file_lattice, part, [&] (size_t index, size_t count, size_t) {
+            const Lattice_accessor::Coordinate voxel = file_lattice.coordinate(index);
+            const double* source = values
+                + ((voxel.x - chunk->x_begin) * y_extent + (voxel.y - chunk->y_begin)) * z_extent + (voxel.z - chunk->z_begin);
+
+            memcpy(output + destination.index(voxel.x - box.x_begin + origin, voxel.y - box.y_begin + origin, voxel.z - box.z_begin + origin),
+                source, count * sizeof(double));
+        });
+    }
+}
+
+std::vector<std::string> Container_reader::component_names()
+{
+    open_container();
+
+    return m_names;
+}
+
+bool Container_reader::stored_with_bounds()
+{
+    open_container();
+
+    return m_header.with_bounds;
+}
+
+const double* Container_reader::mapped_component(size_t position)
+{
+    open_container();
+
+    if (position >= m_names.size() or m_header.chunks_per_component != 1)
+        return nullptr;
+
+    return reinterpret_cast<const double*>(m_mapped_file->begin() + m_chunks[position].offset);
+}
+
+void Container_reader::read_selected(const std::vector<size_t>& positions, const std::vector<std::vector<double>*>& components)
+{
+    open_container();
+
+    const Lattice_accessor::Range box = checked_box(file_lattice.plus_bounds());
+
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        components[i]->assign(file_lattice.system_size, 0.0);
+        copy_component(positions[i], box, 0, file_lattice, components[i]->data());
+    }
+}
+
+void Container_reader::read_selected_subvolume(const std::vector<size_t>& positions, const Lattice_accessor::Range& box, const Lattice_accessor& subvolume, const std::vector<std::vector<double>*>& components)
+{
+    open_container();
+
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        components[i]->assign(subvolume.system_size, 0.0);
+        copy_component(positions[i], box, SYSTEM_EDGE_OFFSET, subvolume, components[i]->data());
+    }
+}
+
+void Container_reader::read_into(std::vector<std::vector<double>>& output)
+{
+    open_container();
+
+    std::vector<size_t> positions(m_names.size());
+    std::vector<std::vector<double>*> components;
+
+    output.resize(m_names.size());
+
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        positions[i] = i;
+        components.push_back(&output[i]);
+    }
+
+    read_selected(positions, components);
+
+    m_headers = m_names;
+}
+
+void Container_reader::read_through_cache(std::vector<std::vector<double>>& output)
+{
+    read_into(output);
+}
+
+std::unique_ptr<const Sidecar::Mapping> Container_reader::map_through_cache(std::vector<std::vector<double>>& output)
+{
+    read_into(output);
+
+    return nullptr;
+}
+
+bool Container_reader::next_component(std::vector<double>& component)
+{
+    open_container();
+
+    if (m_streamed == m_names.size())
+        return false;
+
+    read_selected({m_streamed}, {&component});
+
+    if (m_streamed == 0)
+        m_headers.clear();
+
+    m_headers.push_back(m_names[m_streamed++]);
+
+    return true;
+}
+
+Reader::Reader()
+    : m_read_objects(0)
+{
+    m_file.precision(20);
+}
+
+void Reader::open_reader(Readable_file& file)
 {
     cout << "Reading file " << file.m_filename << ".." << endl;
 
     switch (file.get_filetype())
     {
     case Readable_filetype::VTK_STRUCTURED_GRID:
+    case Readable_filetype::VTK_STRUCTURED_GRID_BINARY:
         m_input_reader = make_unique<Vtk_structured_grid_reader>(file);
         break;
     case Readable_filetype::PRO:
         m_input_reader = make_unique<Pro_reader>(file);
         break;
+    case Readable_filetype::LATTICE_CONTAINER:
+        m_input_reader = make_unique<Container_reader>(file);
+        break;
     default:
         cerr << "Something went horribly wrong while constructing Readable_file. It seems that Readable_filetype is not set properly. Exiting." << endl;
         exit(0);
     }
 
+    m_input_reader->configuration = configuration;
+}
+
+//Callable for multiple files. returns number of objects read.
+size_t Reader::read_objects_in(Readable_file file)
+{
+    open_reader(file);
+
     std::vector<std::vector<double>> t_object;
-    t_object = m_input_reader->get_file_as_vectors();
+    m_input_reader->read_through_cache(t_object);
 
-    m_read_objects.insert(m_read_objects.end(), t_object.begin(), t_object.end());
+    m_read_objects.insert(m_read_objects.end(), make_move_iterator(t_object.begin()), make_move_iterator(t_object.end()));
 
     cout << "Done reading " << m_read_objects.size() << " components." << endl;
 
     return t_object.size();
 }
 
+size_t Reader::read_objects_in(Readable_file file, std::vector<std::vector<double>>& output)
+{
+    open_reader(file);
+
+    m_input_reader->read_through_cache(output);
+
+    cout << "Done reading " << output.size() << " components." << endl;
+
+    return output.size();
+}
+
+std::unique_ptr<const Sidecar::Mapping> Reader::map_objects_in(Readable_file file, std::vector<std::vector<double>>& output)
+{
+    open_reader(file);
+
+    std::unique_ptr<const Sidecar::Mapping> mapping = m_input_reader->map_through_cache(output);
+
+    cout << "Done reading " << (mapping ? mapping->names().size() : output.size()) << " components." << endl;
+
+    return mapping;
+}
+
+size_t Reader::read_objects_in(Readable_file file, const std::vector<std::string>& components, std::vector<std::vector<double>>& output)
+{
+    open_reader(file);
+
+    m_input_reader->read_components(components, output);
+
+    cout << "Done reading " << output.size() << " components." << endl;
+
+    return output.size();
+}
+
+IReader& Reader::stream_objects_in(Readable_file file)
+{
+    open_reader(file);
+
+    return *m_input_reader;
+}
+
+IReader& Reader::open(Readable_file file)
+{
+    open_reader(file);
+
+    return *m_input_reader;
+}
+
 void Reader::push_data_to_objects(std::vector<vector<double>> &output)
 {
     assert(output.size() == m_read_objects.size() && "Please resize your vector vector before passing!");
     for (size_t i = 0; i < m_read_objects.size(); ++i)
-        output[i] = m_read_objects[i];
+        output[i] = std::move(m_read_objects[i]);
 
     m_read_objects.clear();
 }
@@ -2,6 +2,14 @@
 #define FILE_READER_H
 
 #include "lattice_accessor.h"
+#include "lattice_field.h"
+#include "mapped_file.h"
+#include "number_parser.h"
+#include "line_scanner.h"
+#include "thread_pool.h"
+#include "byte_order.h"
+#include "sidecar.h"
+#include "lattice_container.h"
 
 #include <cstdio>
 #include <string>
@@ -15,8 +23,10 @@
 #include <memory>
 #include <cassert>
 #include <cstdlib>
+#include <cctype>
 #include <regex>
 #include <map>
+#include <functional>
 
 /*  
  *  These follow a bridge pattern with prototype IReader, concrete classes filetype_reader and bridge Reader.
@@ -31,7 +41,9 @@
 enum class Readable_filetype {
             NONE,
             VTK_STRUCTURED_GRID,
-            PRO
+            VTK_STRUCTURED_GRID_BINARY,
+            PRO,
+            LATTICE_CONTAINER
         };
 
 //Provides necessary checks before reading file by reader.
@@ -47,6 +59,9 @@ class Readable_file {
         Readable_filetype get_filetype();
         Readable_file(const std::string filename_, Readable_filetype filetype_);
 
+        //Filetype from the extension, and for .vtk from the encoding on its third line. NONE if unknown.
+        static Readable_filetype filetype_of(const std::string& filename);
+
     private:
 
         static std::map<Readable_filetype, std::string> extension_map;
@@ -58,16 +73,85 @@ class Readable_file {
         void read_extension();
 };
 
+//Begin and end of a piece of text, e.g. a chunk of a memory mapped file
+typedef std::pair<const char*, const char*> Text_range;
+
+std::vector<Text_range> split_at_lines(const char* first, const char* last, const size_t parts);
+
+//Parts [first, last) of file is split in for threads threads: one each, or while file is still being read, enough
+//to start parsing the first while the rest comes in
+size_t line_parts(const Mapped_file& file, const char* first, const char* last, const size_t threads);
+//Part part of parts of [first, last), ending right after a newline like those of split_at_lines. Waits for its bytes
+//of file to be in memory.
+Text_range line_part(const Mapped_file& file, const char* first, const char* last, const size_t parts, const size_t part);
+
 //Interface for different filetypes
 class IReader {
     public:
         IReader(Readable_file file);
         virtual ~IReader();
 
-        virtual std::vector<std::vector<double>> get_file_as_vectors() = 0;
+        //Parses the file into output: one vector per component, in namics order with bounds. Vectors already in
+        //output are reused, so the data lands once, in storage the caller owns and may recycle between files.
+        virtual void read_into(std::vector<std::vector<double>>& output) = 0;
+        std::vector<std::vector<double>> get_file_as_vectors();
+        //read_into, but into fields of lattice() that can be handed on without copying. Values the file doesn't
+        //store, e.g. the extra planes of a 1D or 2D lattice, stay zero.
+        virtual void read_fields(std::vector<Lattice_field<double>>& output, Lattice_field<double>::Pages pages = Lattice_field<double>::Pages::DEFAULT);
+        //read_into, but from the sidecar cache when configuration.sidecar_cache is set and the cache is up to date.
+        //Otherwise the file is parsed and the cache (re)written.
+        virtual void read_through_cache(std::vector<std::vector<double>>& output);
+        //With configuration.sidecar_cache set, the sidecar cache mapped read-only, so the components are used in place
+        //without a copy. The file is parsed and the cache written first when it is missing or out of date.
+        //Returns nullptr, with the components parsed into output instead, when configuration.sidecar_cache is not
+        //set, when the cache can't be written, or when the file changed while it was parsed. output is left empty
+        //whenever a mapping is returned.
+        virtual std::unique_ptr<const Sidecar::Mapping> map_through_cache(std::vector<std::vector<double>>& output);
+        //Streams the file instead: every call fills component with the next one, like read_into does, and returns
+        //false after the last. Memory stays at a single component. m_headers[n] names the n-th component.
+        virtual bool next_component(std::vector<double>& component) = 0;
         std::vector<std::string> m_headers;
 
+        //Geometry of the components read, valid once the first one is read or component_names() returned
+        const Lattice_accessor& lattice() const noexcept { return file_lattice; }
+
+        //Reads only the components at the given positions (from 0, in file order) or with the given names into
+        //output, in the order asked for, without parsing the others. m_headers becomes their names.
+        void read_components(const std::vector<size_t>& positions, std::vector<std::vector<double>>& output);
+        void read_components(const std::vector<std::string>& names, std::vector<std::vector<double>>& output);
+        //Names of all components in the file, in file order
+        virtual std::vector<std::string> component_names() = 0;
+
+        //Reads only the voxels inside box, in lattice coordinates of the file (bounds at 0 and M + 1), of all or of
+        //the named components. subvolume becomes the lattice whose interior is the box and output is laid out like
+        //a file of that lattice, with zero bounds. A box one voxel thick is a slice. Coordinates of dimensions the
+        //file doesn't have are ignored.
+        void read_subvolume(const Lattice_accessor::Range& box, Lattice_accessor& subvolume, std::vector<std::vector<double>>& output);
+        void read_subvolume(const Lattice_accessor::Range& box, const std::vector<std::string>& names, Lattice_accessor& subvolume, std::vector<std::vector<double>>& output);
+
+        enum class Read_mode {
+            STREAM,
+            MEMORY_MAPPED,
+            //Text and container files read whole with large queued requests (queued_io.h), io_uring where the
+            //kernel allows it, then parsed like a mapped file. Binary VTK is streamed as before.
+            QUEUED
+        };
+
+        struct Configuration {
+            Read_mode read_mode = Read_mode::STREAM;
+            //More than one thread parses chunks of a memory mapped file in parallel.
+            size_t threads = 1;
+            //Memory mapped .pro reads: store every value at its lattice index while parsing, using the
+            //coordinates in its row, instead of reordering all data afterwards.
+            bool reorder_while_parsing = false;
+            //VTK: keep the offsets of the SCALARS blocks in [file].idx, reused while the file keeps its size and mtime
+            bool persist_block_index = false;
+            //Keep what read_through_cache parsed in [file].cache (see sidecar.h), mapped instead of parsed next time
+            bool sidecar_cache = false;
+        } configuration;
+
     protected:
+        const std::string m_filename;
         std::ifstream m_file;
         Lattice_accessor file_lattice;
         enum error {
@@ -75,29 +159,84 @@ class IReader {
         };
 
         virtual void set_lattice_geometry(const std::vector<std::string>&) = 0;
+        //Reads the components at ascending, distinct positions into components
+        virtual void read_selected(const std::vector<size_t>& positions, const std::vector<std::vector<double>*>& components) = 0;
+        //Reads the voxels in box, as returned by checked_box, of the components at ascending, distinct positions
+        virtual void read_selected_subvolume(const std::vector<size_t>& positions, const Lattice_accessor::Range& box, const Lattice_accessor& subvolume, const std::vector<std::vector<double>*>& components) = 0;
+
+        //Box within the bounds of file_lattice, dimensions it doesn't have set to [0, 1)
+        Lattice_accessor::Range checked_box(Lattice_accessor::Range box) const;
+        //How whole files are brought into memory under configuration.read_mode
+        Mapped_file::Source mapping_source() const noexcept;
+        //Same, for readers that wait_for() the parts of the file they look at
+        Mapped_file::Source read_ahead_source() const noexcept;
 
         virtual std::vector<std::string> tokenize(std::string line, char delimiter);
 
     private:
         //Disable default constructor
         IReader();
+
+        typedef std::function<void(const std::vector<size_t>&, const std::vector<std::vector<double>*>&)> Selection_reader;
+
+        std::vector<size_t> positions_of(const std::vector<std::string>& names);
+        //Hands the distinct positions to read, each with the first component of output asked for at it
+        void read_positions(const std::vector<size_t>& positions, std::vector<std::vector<double>>& output, const Selection_reader& read);
+        void read_subvolume_at(const Lattice_accessor::Range& box, const std::vector<size_t>& positions, Lattice_accessor& subvolume, std::vector<std::vector<double>>& output);
 };
 
 class Pro_reader : public IReader {
     private:
        std::vector<std::vector<double>> m_data;
+       std::unique_ptr<Mapped_file> m_mapped_file;
+       Text_range m_rows;
+       bool m_header_read;
+       size_t m_number_of_components;
+       //Components handed out by next_component
+       size_t m_streamed;
 
+        //Rows with coordinates in box are parsed to index (coordinate - box begin + origin) of destination
+        struct Placement {
+            Lattice_accessor::Range box;
+            const Lattice_accessor* destination;
+            size_t origin;
+        };
+
+        size_t read_header();
         void check_delimiter(const std::string& line);
         void read_dimensions(const std::vector<std::string>& header_tokens);
         void check_component_name_format(const std::string& header_token);
         std::vector<std::string> parse_data(const size_t number_of_components, const size_t first_component_column);
+        std::vector<std::string> parse_mapped_data(const size_t number_of_components, const size_t first_component_column);
+        size_t parse_mapped_rows(const char* position, const char* const end, const size_t number_of_components, const size_t first_component_column, const size_t first_row, const char*& last_line);
+        //Maps the rows after the header and sets the lattice geometry from the last one
+        void map_rows();
+        size_t rows_in_file() const;
+        //Header and mapped rows, once, for streaming and selective reads
+        void open_rows();
+        //Parses the given component columns (ascending) of every mapped row straight to their lattice index
+        void parse_mapped_components_in_place(const std::vector<size_t>& columns, const std::vector<double*>& components);
+        //Same for the rows in [rows.first, rows.second) that are placed, which must fill the box
+        void parse_mapped_components_in_place(const Text_range& rows, const std::vector<size_t>& columns, const std::vector<double*>& components, const Placement& placement);
+        size_t parse_mapped_rows_in_place(const char* position, const char* const end, const std::vector<size_t>& columns, const std::vector<double*>& components, const Placement& placement);
+        //First mapped row whose slowest coordinate (z in 3D) is at least coordinate, by bisection on the sorted rows
+        const char* first_row_from(size_t coordinate) const;
         void set_lattice_geometry(const std::vector<std::string>& last_line);
+        //Reorders from file order (x fastest) to lattice order (z fastest in 3D), component by component
         void adjust_indexing();
 
     public:
         explicit Pro_reader(Readable_file file);
         
-        std::vector<std::vector<double>> get_file_as_vectors();
+        void read_into(std::vector<std::vector<double>>& output);
+        //Memory mapped reads parse straight into the fields
+        void read_fields(std::vector<Lattice_field<double>>& output, Lattice_field<double>::Pages pages = Lattice_field<double>::Pages::DEFAULT);
+        bool next_component(std::vector<double>& component);
+        std::vector<std::string> component_names();
+
+    protected:
+        void read_selected(const std::vector<size_t>& positions, const std::vector<std::vector<double>*>& components);
+        void read_selected_subvolume(const std::vector<size_t>& positions, const Lattice_accessor::Range& box, const Lattice_accessor& subvolume, const std::vector<std::vector<double>*>& components);
 };
 
 
@@ -109,14 +248,138 @@ class Vtk_structured_grid_reader : public IReader {
             ERROR
         };
 
+        enum class Line_type {
+            EMPTY,
+            DIMENSIONS,
+            SCALARS,
+            LOOKUP_TABLE,
+            KEYWORD,
+            NUMBERS
+        };
+
+        //Puts the values of a block, which come in file order without bounds, at their index in a component with bounds
+        class Block_cursor {
+            public:
+                //Sizes output to the lattice with bounds, zeroed
+                Block_cursor(const Lattice_accessor& lattice, std::vector<double>& output);
+                //Continues a block at its first-th value, output is sized already
+                Block_cursor(const Lattice_accessor& lattice, double* output, size_t first);
+                //False if the block holds more values than the lattice
+                bool place(const double* values, size_t count);
+                bool complete() const;
+
+            private:
+                const Lattice_accessor* m_lattice;
+                double* m_output;
+                size_t m_x, m_y, m_z;
+                size_t m_y_first, m_y_last, m_z_last;
+                size_t m_index;
+
+                void seek(size_t first);
+        };
+
+        static Line_type classify_line(const Line_scanner::Line& line);
+        static bool parse_numbers(const Line_scanner::Line& line, std::vector<double>& data);
+        static size_t count_numbers(const Line_scanner::Line& line);
+
         void set_lattice_geometry(const std::vector<std::string>& tokens);
-        STATUS parse_next_data_block(std::vector<double>& data);
-        std::vector<double> with_bounds(std::vector<double>& input);
+        void read_dimensions(const Line_scanner::Line& line);
+        void read_header(Line_scanner& scanner);
+        STATUS find_first_block(Line_scanner& scanner);
+        STATUS parse_next_data_block(Line_scanner& scanner, std::vector<double>& data, std::vector<double>& output);
+        void parse_mapped_blocks(std::vector<std::vector<double>>& output);
+        bool next_binary_block(std::vector<double>* output);
+        size_t block_values() const;
+        size_t binary_type_size(const std::string& type);
+        void read_binary_block(const std::string& type, const std::string& name, std::vector<double>& output);
+        void read_component_name(const Line_scanner::Line& scalars_line);
 
     public:
+        //Where the values of a SCALARS block are, so it can be read without scanning the others
+        struct Block {
+            std::string name;
+            std::string type;
+            //First byte of the values, on the line after LOOKUP_TABLE, and the first byte after them
+            size_t begin;
+            size_t end;
+        };
 
         Vtk_structured_grid_reader(Readable_file file);
-        std::vector< std::vector<double> > get_file_as_vectors();
+        void read_into(std::vector< std::vector<double> >& output);
+        bool next_component(std::vector<double>& component);
+        std::vector<std::string> component_names();
+
+        //Built on first use, from [file].idx when configuration.persist_block_index is set and it is up to date
+        const std::vector<Block>& block_index();
+
+    protected:
+        void read_selected(const std::vector<size_t>& positions, const std::vector<std::vector<double>*>& components);
+        void read_selected_subvolume(const std::vector<size_t>& positions, const Lattice_accessor::Range& box, const Lattice_accessor& subvolume, const std::vector<std::vector<double>*>& components);
+
+    private:
+        //Legacy BINARY encoding: big-endian blocks straight after LOOKUP_TABLE
+        const bool m_binary;
+
+        //Where next_component left off
+        std::unique_ptr<Line_scanner> m_scanner;
+        STATUS m_status;
+        std::vector<double> m_line_values;
+        size_t m_streamed;
+        size_t m_line_number;
+        bool m_has_dimensions;
+
+        std::vector<Block> m_blocks;
+        bool m_indexed;
+        std::unique_ptr<Mapped_file> m_mapped_file;
+
+        void index_ascii_blocks();
+        std::string block_index_filename() const;
+        void save_block_index() const;
+        bool load_block_index();
+        void read_ascii_block(const Block& block, std::vector<double>& output);
+        //Box without bounds, which VTK files don't hold, empty when it has no voxels in the file
+        Lattice_accessor::Range stored_part(const Lattice_accessor::Range& box) const;
+        //Only rows of the box, seeking from one to the next
+        void read_binary_subvolume(const Block& block, const Lattice_accessor::Range& box, const Lattice_accessor& subvolume, std::vector<double>& output);
+        //Counts the values of every line, parses only lines holding values of the box
+        void read_ascii_subvolume(const Block& block, const Lattice_accessor::Range& box, const Lattice_accessor& subvolume, std::vector<double>& output);
+};
+
+//Native .nlc container (lattice_container.h). Components are mapped, not parsed.
+class Container_reader : public IReader {
+    public:
+        explicit Container_reader(Readable_file file);
+
+        void read_into(std::vector<std::vector<double>>& output);
+        //Mapping the container is as fast as a sidecar would be, so there is none
+        void read_through_cache(std::vector<std::vector<double>>& output);
+        std::unique_ptr<const Sidecar::Mapping> map_through_cache(std::vector<std::vector<double>>& output);
+        bool next_component(std::vector<double>& component);
+        std::vector<std::string> component_names();
+
+        //The component where it lies in the mapped file, valid while the reader lives. Without tiles this is laid
+        //out like a namics array of lattice() when stored_with_bounds(), or holds the interior only otherwise.
+        //nullptr for tiled files.
+        const double* mapped_component(size_t position);
+        bool stored_with_bounds();
+
+    protected:
+        void read_selected(const std::vector<size_t>& positions, const std::vector<std::vector<double>*>& components);
+        void read_selected_subvolume(const std::vector<size_t>& positions, const Lattice_accessor::Range& box, const Lattice_accessor& subvolume, const std::vector<std::vector<double>*>& components);
+
+    private:
+        std::unique_ptr<Mapped_file> m_mapped_file;
+        Lattice_container::Header m_header;
+        std::vector<Lattice_container::Chunk> m_chunks;
+        std::vector<std::string> m_names;
+        size_t m_streamed;
+
+        //Maps and checks the file, once
+        void open_container();
+        void set_lattice_geometry(const std::vector<std::string>&);
+        //Copies the chunks of a component that overlap box into output, voxel (x, y, z) to index
+        //(x - box begin + origin) of destination
+        void copy_component(size_t position, const Lattice_accessor::Range& box, size_t origin, const Lattice_accessor& destination, double* output);
 };
 
 class Reader {
@@ -126,14 +389,30 @@ class Reader {
 
         //Callable for multiple files. returns number of objects read.
         size_t read_objects_in(Readable_file file);
+        //Reads straight into output, resized to the number of components, without keeping a copy.
+        size_t read_objects_in(Readable_file file, std::vector< std::vector<double> >& output);
+        //Opens file for streaming with IReader::next_component, one component at a time.
+        IReader& stream_objects_in(Readable_file file);
+        //Opens file without reading anything, for IReader::component_names, read_components or read_subvolume.
+        IReader& open(Readable_file file);
+        //Maps the sidecar cache of file instead of copying it out, see IReader::map_through_cache.
+        std::unique_ptr<const Sidecar::Mapping> map_objects_in(Readable_file file, std::vector< std::vector<double> >& output);
+        //Reads only the named components into output, in the order given.
+        size_t read_objects_in(Readable_file file, const std::vector<std::string>& components, std::vector< std::vector<double> >& output);
+        //Moves the objects read so far into output
         void push_data_to_objects(std::vector< std::vector<double> >& output);
         std::vector<std::string> get_headers() {return m_input_reader->m_headers;};
 
+        //Handed to every IReader constructed by read_objects_in
+        IReader::Configuration configuration;
+
 
     private:
         std::vector< std::vector<double> > m_read_objects;
         std::ifstream m_file;
         std::unique_ptr<IReader> m_input_reader;
+
+        void open_reader(Readable_file& file);
 };
 
 
@@ -1,5 +1,11 @@
 #include "file_writer.h"
 
+#include "byte_order.h"
+#include "number_formatter.h"
+#include "lattice_container.h"
+
+#include <zlib.h>
+
 #include <iomanip>
 
 using namespace std;
@@ -8,13 +14,28 @@ using namespace std;
 
 Register_class<IProfile_writer, Vtk_structured_grid_writer, Writable_filetype, Lattice_accessor*, Writable_file> Vtk_structured_grid_writer_factory(Writable_filetype::VTK_STRUCTURED_GRID);
 Register_class<IProfile_writer, Vtk_structured_points_writer, Writable_filetype, Lattice_accessor*, Writable_file> Vtk_structured_points_writer_factory(Writable_filetype::VTK_STRUCTURED_POINTS);
+Register_class<IProfile_writer, Vtk_structured_grid_writer, Writable_filetype, Lattice_accessor*, Writable_file> Vtk_structured_grid_binary_writer_factory(Writable_filetype::VTK_STRUCTURED_GRID_BINARY);
+Register_class<IProfile_writer, Vtk_structured_points_writer, Writable_filetype, Lattice_accessor*, Writable_file> Vtk_structured_points_binary_writer_factory(Writable_filetype::VTK_STRUCTURED_POINTS_BINARY);
+Register_class<IProfile_writer, Vti_writer, Writable_filetype, Lattice_accessor*, Writable_file> Vti_writer_factory(Writable_filetype::VTK_IMAGE_DATA);
 Register_class<IProfile_writer, Pro_writer, Writable_filetype, Lattice_accessor*, Writable_file> Pro_writer_factory(Writable_filetype::PRO);
+Register_class<IProfile_writer, Container_writer, Writable_filetype, Lattice_accessor*, Writable_file> Container_writer_factory(Writable_filetype::LATTICE_CONTAINER);
 
 map<std::string, Writable_filetype> Profile_writer::output_options {
         {"vtk", Writable_filetype::VTK_STRUCTURED_POINTS},
         {"vtk_structured_grid", Writable_filetype::VTK_STRUCTURED_GRID},
         {"vtk_structured_points", Writable_filetype::VTK_STRUCTURED_POINTS},
+        {"vtk_binary", Writable_filetype::VTK_STRUCTURED_POINTS_BINARY},
+        {"vtk_structured_grid_binary", Writable_filetype::VTK_STRUCTURED_GRID_BINARY},
+        {"vtk_structured_points_binary", Writable_filetype::VTK_STRUCTURED_POINTS_BINARY},
+        {"vti", Writable_filetype::VTK_IMAGE_DATA},
         {"pro", Writable_filetype::PRO},
+        {"nlc", Writable_filetype::LATTICE_CONTAINER},
+    };
+
+map<std::string, IProfile_writer::Number_format> Profile_writer::number_formats {
+        {"fixed", IProfile_writer::Number_format::FIXED},
+        {"shortest", IProfile_writer::Number_format::SHORTEST},
+        {"float", IProfile_writer::Number_format::SHORTEST_FLOAT},
     };
 
 typedef std::string Extension;
@@ -22,7 +43,11 @@ typedef std::string Extension;
 std::map<Writable_filetype, Extension> Writable_file::extension_map {
     {Writable_filetype::VTK_STRUCTURED_GRID, "vtk"},
     {Writable_filetype::VTK_STRUCTURED_POINTS, "vtk"},
-    {Writable_filetype::PRO, "pro"}
+    {Writable_filetype::VTK_STRUCTURED_GRID_BINARY, "vtk"},
+    {Writable_filetype::VTK_STRUCTURED_POINTS_BINARY, "vtk"},
+    {Writable_filetype::VTK_IMAGE_DATA, "vti"},
+    {Writable_filetype::PRO, "pro"},
+    {Writable_filetype::LATTICE_CONTAINER, "nlc"}
 };
 
 Writable_file::Writable_file(const std::string filename_, Writable_filetype filetype_, int identifier_)
@@ -63,7 +88,7 @@ void Writable_file::append_extension()
 }
 
 IProfile_writer::IProfile_writer(Lattice_accessor* geometry_, Writable_file file_)
-: m_geometry{geometry_}, m_file{file_}, m_adapter{*geometry_}
+: m_geometry{geometry_}, m_file{file_}, m_filestream{configuration.queued_io}, m_adapter{*geometry_}
 {
     m_filestream.precision(configuration.precision);
 }
@@ -81,12 +106,187 @@ void IProfile_writer::bind_data(map< string, shared_ptr<IOutput_ptr>>& profiles_
 void IProfile_writer::bind_subystem_loop(Boundary_mode mode_) {
     switch (mode_) {
         case Boundary_mode::WITH_BOUNDS:
-            subsystem_loop = std::bind(&Lattice_accessor::system_plus_bounds, m_adapter, std::placeholders::_1);
+            m_subsystem = m_adapter.plus_bounds();
             break;
         case Boundary_mode::WITHOUT_BOUNDS:
-            subsystem_loop = std::bind(&Lattice_accessor::skip_bounds, m_adapter, std::placeholders::_1);
+            m_subsystem = m_adapter.inside();
             break;
     }
+
+    //Dimensions the lattice doesn't have are a single plane, whatever the bounds, which don't move the index
+    if (m_adapter.dimensionality < 2) {
+        m_subsystem.y_begin = 1;
+        m_subsystem.y_end = 2;
+    }
+
+    if (m_adapter.dimensionality < 3) {
+        m_subsystem.z_begin = 1;
+        m_subsystem.z_end = 2;
+    }
+}
+
+bool IProfile_writer::is_binary()
+{
+    return m_file.get_filetype() == Writable_filetype::VTK_STRUCTURED_GRID_BINARY
+        or m_file.get_filetype() == Writable_filetype::VTK_STRUCTURED_POINTS_BINARY;
+}
+
+//Same voxels, same order as Lattice_accessor::for_each over m_subsystem
+void IProfile_writer::for_each_row(const std::function<void(const Row&)>& function)
+{
+    Row row;
+    row.x = m_subsystem.x_begin;
+    row.length = m_subsystem.x_end - m_subsystem.x_begin;
+
+    for (row.z = m_subsystem.z_begin ; row.z < m_subsystem.z_end ; ++row.z)
+        for (row.y = m_subsystem.y_begin ; row.y < m_subsystem.y_end ; ++row.y) {
+            row.offset = m_geometry->index(row.x, row.y, row.z);
+            function(row);
+        }
+}
+
+std::vector<double> IProfile_writer::gather(IOutput_ptr& profile)
+{
+    const size_t length = m_subsystem.x_end - m_subsystem.x_begin;
+    const size_t y_extent = m_subsystem.y_end - m_subsystem.y_begin;
+    const size_t z_extent = m_subsystem.z_end > m_subsystem.z_begin ? m_subsystem.z_end - m_subsystem.z_begin : 0;
+
+    const size_t z_block_size = GATHER_Z_BLOCK;
+
+    std::vector<double> values(length * y_extent * z_extent);
+
+    //Rows of neighbouring z share cache lines in 3D, so copy a block of them before moving on in y
+    for (size_t z_block = 0 ; z_block < z_extent ; z_block += z_block_size)
+        for (size_t y = 0 ; y < y_extent ; ++y)
+            for (size_t z = z_block ; z < std::min(z_block + z_block_size, z_extent) ; ++z)
+                profile.copy(
+                    m_geometry->index(m_subsystem.x_begin, m_subsystem.y_begin + y, m_subsystem.z_begin + z),
+                    length, m_geometry->jump_x, values.data() + (z * y_extent + y) * length
+                );
+
+    return values;
+}
+
+std::vector<IProfile_writer::Row_range> IProfile_writer::chunk_rows(const std::vector<Row>& rows)
+{
+    std::vector<Row_range> chunks;
+
+    size_t first = 0;
+    size_t voxels = 0;
+
+    for (size_t i = 0; i < rows.size(); ++i) {
+        voxels += rows[i].length;
+
+        if (voxels >= CHUNK_SIZE or i + 1 == rows.size()) {
+            chunks.emplace_back(first, i + 1);
+            first = i + 1;
+            voxels = 0;
+        }
+    }
+
+    return chunks;
+}
+
+void IProfile_writer::write_in_parallel(std::ostream& out, size_t count, const std::function<void(size_t, std::string&)>& format)
+{
+    Thread_pool pool(configuration.threads);
+
+    //A few tasks per thread in flight, the rest waits so memory stays bounded
+    const size_t wave_size = pool.size() * 4;
+    std::vector<std::string> buffers(std::min(wave_size, count));
+
+    for (size_t wave = 0; wave < count; wave += wave_size) {
+        const size_t tasks = std::min(wave_size, count - wave);
+
+        pool.parallel_for(tasks, [wave, &buffers, &format] (size_t task) {
+            buffers[task].clear();
+            format(wave + task, buffers[task]);
+        });
+
+        for (size_t task = 0; task < tasks; ++task)
+            out.write(buffers[task].data(), buffers[task].size());
+    }
+}
+
+void IProfile_writer::write_ascii_vtk_profiles(std::ostream& out)
+{
+    std::vector<Row> rows;
+    for_each_row([&rows] (const Row& row) { rows.push_back(row); });
+
+    const std::vector<Row_range> chunks = chunk_rows(rows);
+    //Tasks are every chunk of every profile, profile by profile
+    std::vector<std::pair<const std::string*, IOutput_ptr*>> profiles;
+    for (auto& profile : m_profiles)
+        profiles.emplace_back(&profile.first, profile.second.get());
+
+    if (chunks.empty()) {
+        for (auto& profile : profiles)
+            out << "SCALARS " << *profile.first << " float\nLOOKUP_TABLE default\n";
+        return;
+    }
+
+    write_in_parallel(out, profiles.size() * chunks.size(),
+        [this, &rows, &chunks, &profiles] (size_t task, std::string& vtk) {
+            const size_t chunk = task % chunks.size();
+            IOutput_ptr& profile = *profiles[task / chunks.size()].second;
+
+            if (chunk == 0)
+                vtk += "SCALARS " + *profiles[task / chunks.size()].first + " float\nLOOKUP_TABLE default\n";
+
+            std::vector<double> values;
+
+            for (size_t r = chunks[chunk].first; r < chunks[chunk].second; ++r) {
+                values.resize(rows[r].length);
+                profile.copy(rows[r].offset, rows[r].length, m_geometry->jump_x, values.data());
+
+                for (double value : values) {
+                    append_value(vtk, value);
+                    vtk += '\n';
+                }
+            }
+        }
+    );
+}
+
+void IProfile_writer::append_value(std::string& text, double value) const
+{
+    switch (configuration.number_format) {
+        case Number_format::SHORTEST:
+            Number_formatter::append_shortest(text, value);
+            break;
+        case Number_format::SHORTEST_FLOAT:
+            Number_formatter::append_shortest_float(text, value);
+            break;
+        default:
+            Number_formatter::append_general(text, value, configuration.precision);
+    }
+}
+
+void IProfile_writer::write_binary_vtk_scalars(std::ostream& out, const std::string& name, IOutput_ptr& profile)
+{
+    std::vector<double> values = gather(profile);
+
+    std::vector<char> bytes;
+
+    switch (configuration.binary_type)
+    {
+    case Binary_type::FLOAT:
+    {
+        std::vector<float> single_precision(values.begin(), values.end());
+        bytes.resize(single_precision.size() * sizeof(float));
+        Byte_order::to_big_endian(single_precision.data(), single_precision.size(), bytes.data());
+        out << "SCALARS " << name << " float\nLOOKUP_TABLE default\n";
+        break;
+    }
+    case Binary_type::DOUBLE:
+        bytes.resize(values.size() * sizeof(double));
+        Byte_order::to_big_endian(values.data(), values.size(), bytes.data());
+        out << "SCALARS " << name << " double\nLOOKUP_TABLE default\n";
+        break;
+    }
+
+    out.write(bytes.data(), bytes.size());
+    out << '\n';
 }
 
 
@@ -105,34 +305,47 @@ void Vtk_structured_grid_writer::prepare_for_data()
 {
     bind_subystem_loop(configuration.boundary_mode);
 
-    m_filestream.open(m_file.get_filename(), std::ios_base::out);
+    m_filestream.open(m_file.get_filename(), std::ios_base::out | std::ios_base::binary);
 
 	std::ostringstream vtk;
 
-    int MX{0};
-
-    if (configuration.boundary_mode == Boundary_mode::WITHOUT_BOUNDS) {
-        MX = m_geometry->MX;
-    } else if (configuration.boundary_mode == Boundary_mode::WITH_BOUNDS) {
-        MX = m_geometry->MX+2;
-    }
-
-	int MY = m_geometry->MY;
-	int MZ = m_geometry->MZ;
+    //Extents of the voxels written, 1 for dimensions the lattice doesn't have
+    const int MX = m_subsystem.x_end - m_subsystem.x_begin;
+    const int MY = m_subsystem.y_end - m_subsystem.y_begin;
+    const int MZ = m_subsystem.z_end - m_subsystem.z_begin;
 
 	vtk << "# vtk DataFile Version 4.2 \n";
 	vtk << "VTK output \n";
-	vtk << "ASCII\n";
+	vtk << (is_binary() ? "BINARY\n" : "ASCII\n");
 	vtk << "DATASET STRUCTURED_GRID \n";
 	vtk << "DIMENSIONS " << MX << " " << MY << " " << MZ << "\n";
 	vtk << "POINTS " << MX * MY * MZ << " int\n";
 
-    subsystem_loop(
-        [this, &vtk] (size_t x, size_t y, size_t z)
-        {
-            vtk << x << " " << y << " " << z << "\n";
-        }
-    );
+    if (is_binary()) {
+        std::vector<int32_t> points;
+        points.reserve(3 * MX * MY * MZ);
+
+        m_adapter.for_each(m_subsystem,
+            [&points] (size_t x, size_t y, size_t z, size_t)
+            {
+                points.push_back(x);
+                points.push_back(y);
+                points.push_back(z);
+            }
+        );
+
+        std::vector<char> bytes(points.size() * sizeof(int32_t));
+        Byte_order::to_big_endian(points.data(), points.size(), bytes.data());
+        vtk.write(bytes.data(), bytes.size());
+        vtk << "\n";
+    } else {
+        m_adapter.for_each(m_subsystem,
+            [&vtk] (size_t x, size_t y, size_t z, size_t)
+            {
+                vtk << x << " " << y << " " << z << "\n";
+            }
+        );
+    }
 
 	vtk << "POINT_DATA " << MX * MY * MZ << "\n";
 
@@ -144,26 +357,17 @@ void Vtk_structured_grid_writer::prepare_for_data()
 
 void Vtk_structured_grid_writer::write()
 {
-	m_filestream.open(m_file.get_filename(), std::ios_base::app);
-
-    for (auto& profile : m_profiles) {
-
-	    std::ostringstream vtk;
-
-	    vtk << "SCALARS " << profile.first << " float\nLOOKUP_TABLE default\n";
-
-	    subsystem_loop(
-            [this, &vtk, profile] (size_t x, size_t y, size_t z)
-            {
-	    		vtk << profile.second->data(x*m_geometry->jump_x+y*m_geometry->jump_y+z*m_geometry->jump_z) << "\n";
-            }
-        );
-
-	    m_filestream << vtk.str();
-	    m_filestream.flush();
+	m_filestream.open(m_file.get_filename(), std::ios_base::app | std::ios_base::binary);
 
+    if (is_binary()) {
+        for (auto& profile : m_profiles)
+            write_binary_vtk_scalars(m_filestream, profile.first, *profile.second);
+    } else {
+        write_ascii_vtk_profiles(m_filestream);
     }
 
+    m_filestream.flush();
+
 	m_filestream.close();
     m_file.increment_identifier();
 }
@@ -183,25 +387,18 @@ void Vtk_structured_points_writer::prepare_for_data()
 {
     bind_subystem_loop(configuration.boundary_mode);
 
-    m_filestream.open(m_file.get_filename(), std::ios_base::out);
+    m_filestream.open(m_file.get_filename(), std::ios_base::out | std::ios_base::binary);
 
 	std::ostringstream vtk;
 
-    int MX{0};
-    int MY{0};
-    int MZ{0};
-
-    if (configuration.boundary_mode == Boundary_mode::WITHOUT_BOUNDS) {
-        MX = m_geometry->MX;
-    } else if (configuration.boundary_mode == Boundary_mode::WITH_BOUNDS) {
-        MX = m_geometry->MX+2;
-        MY = m_geometry->MY+2;
-        MZ = m_geometry->MZ+2;
-    }
+    //Extents of the voxels written, 1 for dimensions the lattice doesn't have
+    const int MX = m_subsystem.x_end - m_subsystem.x_begin;
+    const int MY = m_subsystem.y_end - m_subsystem.y_begin;
+    const int MZ = m_subsystem.z_end - m_subsystem.z_begin;
 
     vtk << "# vtk DataFile Version 4.2 \n";
 	vtk << "VTK output \n";
-	vtk << "ASCII\n";
+	vtk << (is_binary() ? "BINARY\n" : "ASCII\n");
 	vtk << "DATASET STRUCTURED_POINTS \n";
     vtk << "SPACING 1 1 1 \n";
     vtk << "ORIGIN 0 0 0 \n";
@@ -216,28 +413,188 @@ void Vtk_structured_points_writer::prepare_for_data()
 
 void Vtk_structured_points_writer::write()
 {
-    m_filestream.open(m_file.get_filename(), std::ios_base::app);
-    m_filestream << setprecision(14);
+    m_filestream.open(m_file.get_filename(), std::ios_base::app | std::ios_base::binary);
 
-    for (auto& profile : m_profiles) {
+    if (is_binary()) {
+        for (auto& profile : m_profiles)
+            write_binary_vtk_scalars(m_filestream, profile.first, *profile.second);
+    } else {
+        write_ascii_vtk_profiles(m_filestream);
+    }
+
+    m_filestream.flush();
+
+	m_filestream.close();
+    m_file.increment_identifier();
+}
+
+constexpr size_t Vti_writer::BLOCK_SIZE;
+
+Vti_writer::Vti_writer(Lattice_accessor* geometry_, Writable_file file_)
+: IProfile_writer(geometry_, file_)
+{
+    configuration.boundary_mode = Boundary_mode::WITHOUT_BOUNDS;
+}
+
+Vti_writer::~Vti_writer()
+{
+
+}
+
+void Vti_writer::prepare_for_data()
+{
+    //Every .vti file is self contained, so header and data are written together in write()
+    bind_subystem_loop(configuration.boundary_mode);
+}
+
+Vti_writer::Compressed_array Vti_writer::compress(const std::vector<double>& values, Thread_pool& pool)
+{
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(values.data());
+    const size_t size = values.size() * sizeof(double);
+    const size_t number_of_blocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    Compressed_array array;
+    array.blocks.resize(number_of_blocks);
+
+    pool.parallel_for(number_of_blocks, [this, &array, bytes, size] (size_t block) {
+        const size_t block_begin = block * BLOCK_SIZE;
+        const size_t block_size = std::min(BLOCK_SIZE, size - block_begin);
+
+        uLongf compressed_size = compressBound(block_size);
+        array.blocks[block].resize(compressed_size);
+
+        if (compress2(array.blocks[block].data(), &compressed_size, bytes + block_begin, block_size, configuration.compression_level) != Z_OK)
+        {
+            std::cerr << "Compression of .vti data failed.\n";
+            throw 1;
+        }
+
+        array.blocks[block].resize(compressed_size);
+    });
+
+    size_t last_block_size = size - (number_of_blocks > 0 ? (number_of_blocks - 1) * BLOCK_SIZE : 0);
+
+    array.header = {number_of_blocks, BLOCK_SIZE, number_of_blocks > 0 ? last_block_size : 0};
+    for (auto& block : array.blocks)
+        array.header.push_back(block.size());
+
+    return array;
+}
+
+void Vti_writer::write()
+{
+    const size_t MX = m_subsystem.x_end - m_subsystem.x_begin;
+    const size_t MY = m_subsystem.y_end - m_subsystem.y_begin;
+    const size_t MZ = m_subsystem.z_end - m_subsystem.z_begin;
+
+    const bool compressed = configuration.compression_level != 0;
+
+    const uint64_t raw_size = MX * MY * MZ * sizeof(double);
+
+    //Compressed sizes have to be known before the offsets can be written. A sizing pass compresses every profile
+    //but the last, whose size no offset depends on. Their blocks are kept while they fit in the raw size of one
+    //profile, the others are compressed again when they are written, so memory stays at about one profile.
+    std::unique_ptr<Thread_pool> pool;
+    std::vector<Compressed_array> compressed_arrays(m_profiles.size());
+    std::vector<uint64_t> compressed_sizes(m_profiles.size(), 0);
+
+    if (compressed) {
+        pool.reset(new Thread_pool(configuration.threads));
+
+        uint64_t kept = 0;
+        size_t i = 0;
 
-	    std::ostringstream vtk;
+        for (auto& profile : m_profiles) {
+            if (i + 1 == m_profiles.size())
+                break;
 
-        vtk.precision(14);
+            Compressed_array array = compress(gather(*profile.second), *pool);
 
-        vtk << "SCALARS " << profile.first << " float\nLOOKUP_TABLE default\n";
+            compressed_sizes[i] = array.header.size() * sizeof(uint64_t);
+            for (auto& block : array.blocks)
+                compressed_sizes[i] += block.size();
 
-        subsystem_loop(
-            [this, &vtk, profile] (size_t x, size_t y, size_t z) {
-	    		vtk << profile.second->data(x*m_geometry->jump_x+y*m_geometry->jump_y+z*m_geometry->jump_z) << "\n";
+            if (kept + compressed_sizes[i] <= raw_size) {
+                kept += compressed_sizes[i];
+                compressed_arrays[i] = std::move(array);
             }
-        );
 
-        m_filestream << vtk.str();
-        m_filestream.flush();
+            ++i;
+        }
     }
 
-	m_filestream.close();
+    std::ostringstream vti;
+
+    vti << "<?xml version=\"1.0\"?>\n";
+    vti << "<VTKFile type=\"ImageData\" version=\"1.0\" byte_order=\""
+        << (Byte_order::host_is_big_endian() ? "BigEndian" : "LittleEndian") << "\" header_type=\"UInt64\"";
+    if (compressed)
+        vti << " compressor=\"vtkZLibDataCompressor\"";
+    vti << ">\n";
+
+    std::ostringstream extent;
+    extent << "0 " << MX-1 << " 0 " << MY-1 << " 0 " << MZ-1;
+
+    vti << "  <ImageData WholeExtent=\"" << extent.str() << "\" Origin=\"0 0 0\" Spacing=\"1 1 1\">\n";
+    vti << "    <Piece Extent=\"" << extent.str() << "\">\n";
+    vti << "      <PointData>\n";
+
+    uint64_t offset = 0;
+    size_t i = 0;
+
+    for (auto& profile : m_profiles) {
+        vti << "        <DataArray type=\"Float64\" Name=\"" << profile.first << "\" format=\"appended\" offset=\"" << offset << "\"/>\n";
+
+        offset += compressed ? compressed_sizes[i] : sizeof(uint64_t) + raw_size;
+        ++i;
+    }
+
+    vti << "      </PointData>\n";
+    vti << "    </Piece>\n";
+    vti << "  </ImageData>\n";
+    vti << "  <AppendedData encoding=\"raw\">\n   _";
+
+    m_filestream.open(m_file.get_filename(), std::ios_base::out | std::ios_base::binary);
+
+    if (!m_filestream) {
+        std::cerr << "Could not open output file " << m_file.get_filename() << '\n';
+        throw 1;
+    }
+
+    m_filestream << vti.str();
+
+    i = 0;
+    for (auto& profile : m_profiles) {
+        if (compressed) {
+            Compressed_array& array = compressed_arrays[i];
+
+            if (array.header.empty())
+                array = compress(gather(*profile.second), *pool);
+
+            m_filestream.write(reinterpret_cast<const char*>(array.header.data()), array.header.size() * sizeof(uint64_t));
+            for (auto& block : array.blocks)
+                m_filestream.write(reinterpret_cast<const char*>(block.data()), block.size());
+
+            //Done with it, keep memory down
+            std::vector<std::vector<unsigned char>>().swap(array.blocks);
+        } else {
+            std::vector<double> values = gather(*profile.second);
+            uint64_t size = values.size() * sizeof(double);
+            m_filestream.write(reinterpret_cast<const char*>(&size), sizeof(uint64_t));
+            m_filestream.write(reinterpret_cast<const char*>(values.data()), size);
+        }
+        ++i;
+    }
+
+    m_filestream << "\n  </AppendedData>\n</VTKFile>\n";
+
+    //Queued writes only report failures once they are all done
+    m_filestream.close();
+
+    if (!m_filestream) {
+        std::cerr << "Could not write " << m_file.get_filename() << '\n';
+        throw 1;
+    }
     m_file.increment_identifier();
 }
 
@@ -254,81 +611,196 @@ Pro_writer::~Pro_writer()
 
 void Pro_writer::prepare_for_data()
 {
+    //Coordinates and components are written together in write()
     bind_subystem_loop(configuration.boundary_mode);
-    
+}
+
+void Pro_writer::write()
+{
     m_filestream.open(m_file.get_filename(), std::ios_base::out);
 
-	std::ostringstream pro;
+    if (!m_filestream) {
+        std::cerr << "Could not open output file " << m_file.get_filename() << '\n';
+        throw 1;
+    }
 
-    pro << "x";
+    const size_t dimensionality = m_geometry->dimensionality;
 
-    if (m_geometry->dimensionality > 1)
-    {
-        pro << "\ty";
-    }   
+    std::string pro = "x";
 
-    if (m_geometry->dimensionality > 2)
-    {
-        pro << "\tz";
+    if (dimensionality > 1)
+        pro += "\ty";
+
+    if (dimensionality > 2)
+        pro += "\tz";
+
+    std::vector<IOutput_ptr*> profiles;
+
+    for (auto& profile : m_profiles) {
+        pro += '\t';
+        pro += profile.first;
+        profiles.push_back(profile.second.get());
     }
 
-    pro << '\n';
+    pro += '\n';
 
-    subsystem_loop(
-        [this, &pro] (size_t x, size_t y, size_t z) {
-			pro << x;
-            if (m_geometry->dimensionality > 1)
-            {
-                pro << "\t" << y;
-                if (m_geometry->dimensionality > 1)
-                {
-                    pro << "\t" << z;
+    m_filestream << pro;
+
+    std::vector<Row> rows;
+    for_each_row([&rows] (const Row& row) { rows.push_back(row); });
+
+    const std::vector<Row_range> chunks = chunk_rows(rows);
+
+    write_in_parallel(m_filestream, chunks.size(),
+        [this, &rows, &chunks, &profiles, dimensionality] (size_t chunk, std::string& pro) {
+            //One row of values per profile
+            std::vector<std::vector<double>> values(profiles.size());
+
+            for (size_t r = chunks[chunk].first; r < chunks[chunk].second; ++r) {
+                const Row& row = rows[r];
+
+                for (size_t i = 0; i < profiles.size(); ++i) {
+                    values[i].resize(row.length);
+                    profiles[i]->copy(row.offset, row.length, m_geometry->jump_x, values[i].data());
                 }
 
+                for (size_t n = 0; n < row.length; ++n) {
+                    Number_formatter::append_unsigned(pro, row.x + n);
+
+                    if (dimensionality > 1) {
+                        pro += '\t';
+                        Number_formatter::append_unsigned(pro, row.y);
+                    }
+
+                    if (dimensionality > 2) {
+                        pro += '\t';
+                        Number_formatter::append_unsigned(pro, row.z);
+                    }
+
+                    for (std::vector<double>& profile_values : values) {
+                        pro += '\t';
+                        append_value(pro, profile_values[n]);
+                    }
+
+                    pro += '\n';
+                }
             }
-            pro << '\n';
         }
     );
 
-    m_filestream << pro.str();
-	m_filestream.flush();
-
 	m_filestream.close();
+    m_file.increment_identifier();
 }
 
-void Pro_writer::write()
+Container_writer::Container_writer(Lattice_accessor* geometry_, Writable_file file_)
+: IProfile_writer(geometry_, file_)
 {
-    string temp_filename = m_file.get_filename()+".temp";
+    configuration.boundary_mode = Boundary_mode::WITH_BOUNDS;
+}
 
+Container_writer::~Container_writer()
+{
+
+}
+
+void Container_writer::prepare_for_data()
+{
+    bind_subystem_loop(configuration.boundary_mode);
+}
+
+void Container_writer::write()
+{
+    const bool with_bounds = configuration.boundary_mode == Boundary_mode::WITH_BOUNDS;
+    const Lattice_accessor::Range stored = Lattice_container::stored_range(*m_geometry, with_bounds);
+
+    std::vector<Lattice_accessor::Range> tiles;
+
+    if (configuration.tile == 0) {
+        tiles.push_back(stored);
+    } else {
+        Lattice_accessor::Tile tile;
+        tile.x = tile.y = tile.z = configuration.tile;
+        m_geometry->for_each_block(stored, [&tiles] (const Lattice_accessor::Range& block) { tiles.push_back(block); }, tile);
+    }
+
+    std::string names;
     for (auto& profile : m_profiles) {
-        m_filestream.open(temp_filename, std::ios_base::out);
-        std::ifstream in_file(m_file.get_filename());
-        if (!in_file) {
-            std::cerr << "Could not open input file. Did you prepare for data?\n";
-            throw 1;
+        names += profile.first;
+        names += '\0';
+    }
+
+    Lattice_container::Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, Lattice_container::MAGIC, sizeof(header.magic));
+    header.version = Lattice_container::VERSION;
+    header.byte_order = Lattice_container::BYTE_ORDER_MARK;
+    header.dimensionality = m_geometry->dimensionality;
+    header.with_bounds = with_bounds;
+    header.MX = m_geometry->MX;
+    header.MY = m_geometry->MY;
+    header.MZ = m_geometry->MZ;
+    header.components = m_profiles.size();
+    header.tile_x = header.tile_y = header.tile_z = configuration.tile;
+    header.chunks_per_component = tiles.size();
+    header.names_offset = sizeof(header);
+    header.names_size = names.size();
+    header.index_offset = Lattice_container::aligned(header.names_offset + header.names_size, sizeof(uint64_t));
+
+    //Blocks follow the index, component after component, each on its own page
+    std::vector<Lattice_container::Chunk> index;
+    size_t offset = header.index_offset + m_profiles.size() * tiles.size() * sizeof(Lattice_container::Chunk);
+
+    for (size_t component = 0 ; component < m_profiles.size() ; ++component)
+        for (const Lattice_accessor::Range& tile : tiles) {
+            const size_t values = (tile.x_end - tile.x_begin) * (tile.y_end - tile.y_begin) * (tile.z_end - tile.z_begin);
+
+            offset = Lattice_container::aligned(offset);
+            index.push_back({tile.x_begin, tile.x_end, tile.y_begin, tile.y_end, tile.z_begin, tile.z_end, offset, values});
+            offset += values * sizeof(double);
         }
 
-	    std::ostringstream pro;
+    m_filestream.open(m_file.get_filename(), std::ios_base::out | std::ios_base::binary);
 
-        std::string in;
-        std::getline(in_file, in);
-        m_filestream << in << "\t" << profile.first << '\n';
+    if (!m_filestream) {
+        std::cerr << "Could not open output file " << m_file.get_filename() << '\n';
+        throw 1;
+    }
 
-        subsystem_loop(
-            [this, &pro, &in, &in_file, profile] (size_t x, size_t y, size_t z) {
-                std::getline(in_file, in);
-                m_filestream << in << "\t" << profile.second->data(x*m_geometry->jump_x+y*m_geometry->jump_y+z*m_geometry->jump_z) << "\n";
-                m_filestream << pro.str();
-	            m_filestream.flush();
-            }
-        );
+    std::vector<char> padding(Lattice_container::ALIGNMENT, 0);
+    size_t position = 0;
 
-        in_file.close();
-        m_filestream.close();
+    auto write_at = [this, &padding, &position] (size_t at, const void* bytes, size_t size) {
+        m_filestream.write(padding.data(), at - position);
+        m_filestream.write(static_cast<const char*>(bytes), size);
+        position = at + size;
+    };
 
-        rename(temp_filename.c_str(), m_file.get_filename().c_str());
-    }
+    write_at(0, &header, sizeof(header));
+    write_at(header.names_offset, names.data(), names.size());
+    write_at(header.index_offset, index.data(), index.size() * sizeof(Lattice_container::Chunk));
 
-	m_filestream.close();
+    std::vector<double> values;
+    size_t chunk = 0;
+
+    for (auto& profile : m_profiles)
+        for (const Lattice_accessor::Range& tile : tiles) {
+            values.resize(index[chunk].values);
+
+            //Runs along the innermost dimension have unit stride in the source
+            Lattice_container::for_each_run(*m_geometry, tile, [&profile, &values] (size_t source, size_t count, size_t first) {
+                profile.second->copy(source, count, 1, values.data() + first);
+            });
+
+            write_at(index[chunk].offset, values.data(), values.size() * sizeof(double));
+            ++chunk;
+        }
+
+    //Queued writes only report failures once they are all done
+    m_filestream.close();
+
+    if (!m_filestream) {
+        std::cerr << "Could not write " << m_file.get_filename() << '\n';
+        throw 1;
+    }
     m_file.increment_identifier();
-}
\ No newline at end of file
+}
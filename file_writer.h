@@ -3,6 +3,8 @@
 
 #include "factory.h"
 #include "lattice_accessor.h"
+#include "thread_pool.h"
+#include "queued_io.h"
 
 #include <string>
 #include <memory>
@@ -24,7 +26,11 @@ enum class Writable_filetype
     CSV,
     VTK_STRUCTURED_GRID,
     VTK_STRUCTURED_POINTS,
-    PRO
+    VTK_STRUCTURED_GRID_BINARY,
+    VTK_STRUCTURED_POINTS_BINARY,
+    VTK_IMAGE_DATA,
+    PRO,
+    LATTICE_CONTAINER
 };
 
 struct Header {
@@ -35,31 +41,42 @@ struct Header {
 
 class IOutput_ptr {
     public:
+        virtual ~IOutput_ptr() {}
         virtual std::string data(const size_t = 0) = 0;
+        virtual double value(const size_t = 0) = 0;
+        //Bulk access: count values lying stride apart (e.g. jump_x), starting at offset, converted to double.
+        virtual void copy(const size_t offset, const size_t count, const size_t stride, double* destination) = 0;
 };
 
 template<typename T>
 class Output_ptr : public IOutput_ptr
 {
-    std::vector<double> buffer;
-
     public:
         Output_ptr(T* parameter_)
-        : buffer{0}, parameter{parameter_}
+        : parameter{parameter_}
         {
         }
 
         std::string data(const size_t offset = 0) override
         {
-            const T* data = new T;
-
-            data = parameter+offset;
-
             std::ostringstream out;
-            out << *data;
+            out << parameter[offset];
             return out.str();
         }
 
+        double value(const size_t offset = 0) override
+        {
+            return static_cast<double>(parameter[offset]);
+        }
+
+        void copy(const size_t offset, const size_t count, const size_t stride, double* destination) override
+        {
+            const T* source = parameter + offset;
+
+            for (size_t i = 0; i < count; ++i)
+                destination[i] = static_cast<double>(source[i * stride]);
+        }
+
         const T* parameter;
 };
 
@@ -83,7 +100,7 @@ class IProfile_writer
 {
     public:
         IProfile_writer(Lattice_accessor*, Writable_file);
-        ~IProfile_writer();
+        virtual ~IProfile_writer();
 
         virtual void write() = 0;
 
@@ -93,9 +110,37 @@ class IProfile_writer
             WITHOUT_BOUNDS
         };
 
+        //Scalar type written by the binary writers
+        enum class Binary_type
+        {
+            FLOAT,
+            DOUBLE
+        };
+
+        //How the text writers print values
+        enum class Number_format
+        {
+            //configuration.precision significant digits
+            FIXED,
+            //Fewest digits that read back to the same double
+            SHORTEST,
+            //Fewest digits that read back to the same float, matches the "float" VTK headers
+            SHORTEST_FLOAT
+        };
+
         struct Configuration {
             Boundary_mode boundary_mode;
             size_t precision = DEFAULT_PRECISION;
+            Number_format number_format = Number_format::FIXED;
+            Binary_type binary_type = Binary_type::DOUBLE;
+            //zlib level for writers that compress, 0 disables compression
+            int compression_level = 0;
+            //Native container: components stored in tiles of this many voxels along every dimension, 0 stores them whole
+            size_t tile = 0;
+            //Write files in large queued requests (queued_io.h), io_uring where the kernel allows it, instead of
+            //through std::filebuf. Read when the file is opened.
+            bool queued_io = false;
+            size_t threads = Thread_pool::default_thread_count();
         } configuration;
 
         virtual void prepare_for_data() = 0;
@@ -103,23 +148,59 @@ class IProfile_writer
 
         static constexpr uint8_t DEFAULT_PRECISION = 14;
 
+        //Voxels formatted by a single task in write_in_parallel
+        static constexpr size_t CHUNK_SIZE = 1 << 16;
+
+        //Rows along z gathered together, enough to use whole cache lines of the source
+        static constexpr size_t GATHER_Z_BLOCK = 16;
+
     protected:
         Lattice_accessor* m_geometry;
         Writable_file m_file;
         std::map< std::string, std::shared_ptr<IOutput_ptr> > m_profiles;
-        std::ofstream m_filestream;
+        Queued_io::Output_file m_filestream;
         Lattice_accessor m_adapter;
 
         virtual void bind_subystem_loop(Boundary_mode);
 
-        std::function<void(
-            std::function<void(size_t, size_t, size_t)>
-        )> subsystem_loop;
+        //Voxels of m_subsystem, grouped in runs along x. Consecutive voxels in a row are jump_x apart.
+        struct Row {
+            size_t x;
+            size_t y;
+            size_t z;
+            size_t length;
+            size_t offset;
+        };
+
+        void for_each_row(const std::function<void(const Row&)>&);
+
+        bool is_binary();
+        //Profile values in m_subsystem order
+        std::vector<double> gather(IOutput_ptr&);
+        //Writes the SCALARS block of a profile as big-endian configuration.binary_type
+        void write_binary_vtk_scalars(std::ostream&, const std::string&, IOutput_ptr&);
+        //Writes the SCALARS blocks of all profiles as text with configuration.precision digits
+        void write_ascii_vtk_profiles(std::ostream&);
+
+        //Appends value as text, formatted according to configuration.number_format
+        void append_value(std::string&, double) const;
+
+        //Rows of for_each_row, split in ranges [first, last) of about CHUNK_SIZE voxels each
+        typedef std::pair<size_t, size_t> Row_range;
+        std::vector<Row_range> chunk_rows(const std::vector<Row>&);
+
+        //Formats tasks 0 .. count-1 on configuration.threads threads, each into its own buffer,
+        //and writes the buffers to the stream in task order.
+        void write_in_parallel(std::ostream&, size_t count, const std::function<void(size_t, std::string&)>&);
+
+        //Voxels written, set by bind_subystem_loop: inside() or plus_bounds() of the lattice
+        Lattice_accessor::Range m_subsystem;
 };
 
 namespace Profile_writer {
     typedef Factory_template<IProfile_writer, Writable_filetype, Lattice_accessor*, Writable_file> Factory;
     extern std::map<std::string, Writable_filetype> output_options;
+    extern std::map<std::string, IProfile_writer::Number_format> number_formats;
 }
 
 class Vtk_structured_grid_writer : public IProfile_writer
@@ -142,6 +223,29 @@ class Vtk_structured_points_writer : public IProfile_writer
         virtual void prepare_for_data() override;
 
 };
+//VTK XML ImageData (.vti) with all profiles as appended raw, optionally zlib compressed, arrays.
+class Vti_writer : public IProfile_writer
+{
+    public:
+        Vti_writer(Lattice_accessor*, Writable_file);
+        ~Vti_writer();
+
+        virtual void write() override;
+        virtual void prepare_for_data() override;
+
+        //Uncompressed bytes per compressed block
+        static constexpr size_t BLOCK_SIZE = 1 << 20;
+
+    private:
+        //Header (block count, block size, last block size, compressed sizes) followed by the compressed blocks
+        struct Compressed_array {
+            std::vector<uint64_t> header;
+            std::vector<std::vector<unsigned char>> blocks;
+        };
+
+        Compressed_array compress(const std::vector<double>&, Thread_pool&);
+};
+
 class Pro_writer : public IProfile_writer
 {
     public:
@@ -152,6 +256,17 @@ class Pro_writer : public IProfile_writer
         virtual void prepare_for_data() override;
 };
 
+//Native .nlc container (lattice_container.h), with bounds by default so components map as namics arrays
+class Container_writer : public IProfile_writer
+{
+    public:
+        Container_writer(Lattice_accessor*, Writable_file);
+        ~Container_writer();
+
+        virtual void write() override;
+        virtual void prepare_for_data() override;
+};
+
 
 class IParameter_writer
 {
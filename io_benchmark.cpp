@@ -0,0 +1,242 @@
+#include "file_reader.h"
+#include "mapped_file.h"
+#include "queued_io.h"
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+using namespace boost::program_options;
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <exception>
+#include <functional>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+//Drops the file from the page cache, so reads come from disk. Best effort: tmpfs and dirty pages stay.
+void evict(const string& filename)
+{
+    const int fd = open(filename.c_str(), O_RDONLY);
+
+    if (fd == -1)
+        return;
+
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+//Best of repeats runs of run, in MB/s of bytes. prepare runs untimed before every run.
+void measure(const string& name, size_t bytes, size_t repeats, const function<void()>& prepare, const function<void()>& run)
+{
+    double best = 0;
+
+    for (size_t i = 0 ; i < repeats ; ++i)
+    {
+        prepare();
+
+        const auto start = chrono::steady_clock::now();
+        run();
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        if (best == 0 or seconds < best)
+            best = seconds;
+    }
+
+    cout << left << setw(36) << name << right << setw(10) << fixed << setprecision(3) << best << " s"
+         << setw(10) << setprecision(0) << bytes / best / 1e6 << " MB/s" << endl;
+}
+
+int main(int argc , char **argv)
+{
+    options_description desc("\nCompare the throughput of the ifstream/ofstream, memory mapped and queued (io_uring or blocking) I/O paths.\nAllowed arguments");
+
+    desc.add_options()
+        ("help,h", "Print this help text.")
+        ("input-file,i", value< string >(), "File read by the benchmark, pro, vtk or nlc for the parser runs.")
+        ("output-file,o", value< string >()->default_value("io_benchmark.out"), "Scratch file written by the write runs, removed afterwards.")
+        ("repeats,r", value< size_t >()->default_value(3), "[int] Runs per path, the best one counts.")
+        ("piece,p", value< size_t >()->default_value(4096), "[int] Bytes handed to the stream per write call.")
+        ("warm,w", "Leave the input in the page cache instead of dropping it before every read.")
+        ("no-parse,n", "Skip the parser runs.");
+
+    positional_options_description p;
+    p.add("input-file", -1);
+
+    variables_map vm;
+    try
+    {
+        store( command_line_parser( argc, argv).options(desc).positional(p).run(), vm );
+        notify(vm);
+
+    } catch (std::exception &e)
+    {
+        cerr << endl << e.what() << endl;
+        cerr << desc << endl;
+    }
+
+    if (vm.count("help")) {
+        cerr << desc << endl;
+        exit(0);
+    }
+
+    if (!vm.count("input-file")) {
+        cerr << "No input file specified." << endl;
+        exit(0);
+    }
+
+    const string input = vm["input-file"].as< string >();
+    const string output = vm["output-file"].as< string >();
+    const size_t repeats = vm["repeats"].as< size_t >();
+    const size_t piece = max<size_t>(vm["piece"].as< size_t >(), 1);
+    const bool warm = vm.count("warm");
+
+    vector<char> contents;
+
+    {
+        ifstream file(input, ios::binary);
+
+        if (!file) {
+            cerr << "Could not open " << input << endl;
+            exit(0);
+        }
+
+        contents.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    }
+
+    const size_t size = contents.size();
+
+    cout << input << ": " << size << " bytes, io_uring " << (Queued_io::uring_available() ? "available" : "not available")
+         << ", page cache " << (warm ? "warm" : "dropped before every read") << endl << endl;
+
+    //Keeps the compiler from skipping reads whose result isn't used
+    volatile size_t sink = 0;
+
+    const auto cold = [&] {
+        if (not warm)
+            evict(input);
+    };
+
+    //Every write starts from a new file, truncating the last one would be timed as well
+    const auto fresh = [&] {
+        remove(output.c_str());
+    };
+
+    /***** READ *****/
+    measure("ifstream getline", size, repeats, cold, [&] {
+        ifstream file(input, ios::binary);
+        string line;
+        size_t lines = 0;
+
+        while (getline(file, line))
+            ++lines;
+
+        sink = lines;
+    });
+
+    measure("ifstream read", size, repeats, cold, [&] {
+        ifstream file(input, ios::binary);
+        vector<char> buffer(size);
+        file.read(buffer.data(), size);
+        sink = file.gcount();
+    });
+
+    measure("memory map, every page touched", size, repeats, cold, [&] {
+        Mapped_file file(input);
+        size_t sum = 0;
+
+        for (const char* page = file.begin() ; page < file.end() ; page += Queued_io::ALIGNMENT)
+            sum += *page;
+
+        sink = sum;
+    });
+
+    for (bool uring : {true, false}) {
+        if (uring and not Queued_io::uring_available())
+            continue;
+
+        Queued_io::use_uring(uring);
+
+        measure(uring ? "queued read, io_uring" : "queued read, blocking", size, repeats, cold, [&] {
+            Mapped_file file(input, Mapped_file::Source::QUEUED_READ);
+            sink = file.size();
+        });
+    }
+
+    Queued_io::use_uring(true);
+
+    /***** WRITE *****/
+    cout << endl;
+
+    measure("ofstream write", size, repeats, fresh, [&] {
+        ofstream file(output, ios::binary);
+
+        for (size_t offset = 0 ; offset < size ; offset += piece)
+            file.write(contents.data() + offset, min(piece, size - offset));
+    });
+
+    for (bool uring : {true, false}) {
+        if (uring and not Queued_io::uring_available())
+            continue;
+
+        Queued_io::use_uring(uring);
+
+        measure(uring ? "queued write, io_uring" : "queued write, blocking", size, repeats, fresh, [&] {
+            const bool queued = true;
+            Queued_io::Output_file file(queued);
+            file.open(output, ios::binary);
+
+            for (size_t offset = 0 ; offset < size ; offset += piece)
+                file.write(contents.data() + offset, min(piece, size - offset));
+
+            file.close();
+
+            if (!file)
+                cerr << "Writing " << output << " failed." << endl;
+        });
+    }
+
+    Queued_io::use_uring(true);
+    remove(output.c_str());
+
+    /***** PARSE *****/
+    const Readable_filetype filetype = Readable_file::filetype_of(input);
+
+    if (vm.count("no-parse") or filetype == Readable_filetype::NONE)
+        return 0;
+
+    cout << endl;
+
+    const vector<pair<string, IReader::Read_mode>> modes {
+        {"parse, stream", IReader::Read_mode::STREAM},
+        {"parse, memory mapped", IReader::Read_mode::MEMORY_MAPPED},
+        {"parse, queued", IReader::Read_mode::QUEUED}
+    };
+
+    //The readers report every file they open
+    streambuf* const cout_buffer = cout.rdbuf();
+    ostringstream quiet;
+
+    for (auto& mode : modes)
+        measure(mode.first, size, repeats, cold, [&] {
+            cout.rdbuf(quiet.rdbuf());
+
+            Reader reader;
+            reader.configuration.read_mode = mode.second;
+            vector<vector<double>> components;
+            reader.open(Readable_file(input, filetype)).read_into(components);
+
+            cout.rdbuf(cout_buffer);
+            quiet.str("");
+            sink = components.size();
+        });
+}
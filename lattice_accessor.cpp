@@ -1,7 +1,9 @@
 #include "lattice_accessor.h"
 
+#include <algorithm>
+
 Lattice_accessor::Lattice_accessor() :
-MX{0}, MY{0}, MZ{0}, dimensionality{static_cast<Dimensionality>(1)} 
+MX{0}, MY{0}, MZ{0}, system_size{0}, dimensionality{static_cast<Dimensionality>(1)}, jump_x{0}, jump_y{0}, jump_z{0}
 {}
 
 void Lattice_accessor::set_jumps() noexcept {
@@ -23,59 +25,103 @@ void Lattice_accessor::set_jumps() noexcept {
         break;
     }
     system_size = (MZ+BOUNDARIES)*(MY+BOUNDARIES)*(MX+BOUNDARIES);
+
+    m_divide_x = Divider(jump_x);
+    m_divide_y = Divider(std::max<size_t>(jump_y, 1));
 }
 
-const Lattice_accessor::Coordinate Lattice_accessor::coordinate(size_t index) {
-    
-    size_t mod = 0;
-    Coordinate coordinate;
+Lattice_accessor::Coordinate Lattice_accessor::coordinate(size_t index) const noexcept {
+    Coordinate coordinate{0, 0, 0};
 
-    coordinate[Dimension::X] = index / jump_x;
-    mod = index % jump_x;
+    coordinate.x = m_divide_x.quotient(index);
 
     if (dimensionality > 1) {
-        coordinate[Dimension::Y] = mod / jump_y;
-        mod = mod % jump_y;
-    }
+        const size_t mod = index - coordinate.x * jump_x;
+        coordinate.y = m_divide_y.quotient(mod);
 
-    if (dimensionality > 2) {
-        coordinate[Dimension::Z] = mod / jump_z;
+        if (dimensionality > 2)
+            coordinate.z = mod - coordinate.y * jump_y;
     }
+
     return coordinate;
 }
 
-void Lattice_accessor::skip_bounds(std::function<void(size_t, size_t, size_t)> function) noexcept {
-size_t x{0};
-size_t y{0};
-
-    for ( size_t z = SYSTEM_EDGE_OFFSET ; z < MZ+SYSTEM_EDGE_OFFSET ; ++z ) {
-        y = SYSTEM_EDGE_OFFSET;
-        do {
-            x = SYSTEM_EDGE_OFFSET;
-            do {
-                function(x, y, z);
-                ++x;
-            } while (x < MX+SYSTEM_EDGE_OFFSET );
-            ++y;
-        } while (y < MY+SYSTEM_EDGE_OFFSET );
+Lattice_accessor::Range Lattice_accessor::inside() const noexcept {
+    //y and x run at least once, like the do-while loops they replace
+    return {
+        SYSTEM_EDGE_OFFSET, std::max<size_t>(MX, 1) + SYSTEM_EDGE_OFFSET,
+        SYSTEM_EDGE_OFFSET, std::max<size_t>(MY, 1) + SYSTEM_EDGE_OFFSET,
+        SYSTEM_EDGE_OFFSET, MZ + SYSTEM_EDGE_OFFSET
+    };
+}
+
+Lattice_accessor::Range Lattice_accessor::plus_bounds() const noexcept {
+    return {0, MX + BOUNDARIES, 0, MY + BOUNDARIES, 0, MZ + BOUNDARIES};
+}
+
+Lattice_accessor::Range Lattice_accessor::lower_boundary(Dimension dimension) const noexcept {
+    Range range = plus_bounds();
+
+    switch (dimension) {
+    case Dimension::X:
+        range.x_end = 1;
+        break;
+    case Dimension::Y:
+        range.y_end = 1;
+        break;
+    case Dimension::Z:
+        range.z_end = 1;
+        break;
+    default:
+        break;
     }
+
+    return range;
 }
 
-void Lattice_accessor::system_plus_bounds(std::function<void(size_t, size_t, size_t)> function) noexcept {
-size_t x{0};
-size_t y{0};
-
-    for ( size_t z = 0 ; z < MZ+BOUNDARIES ; ++z ) {
-        y = 0;
-        do {
-            x = 0;
-            do {
-                function(x, y, z);
-                ++x;
-            } while (x < MX+BOUNDARIES );
-            ++y;
-        } while (y < MY+BOUNDARIES );
+Lattice_accessor::Range Lattice_accessor::upper_boundary(Dimension dimension) const noexcept {
+    Range range = plus_bounds();
+
+    switch (dimension) {
+    case Dimension::X:
+        range.x_begin = MX + SYSTEM_EDGE_OFFSET;
+        range.x_end = range.x_begin + 1;
+        break;
+    case Dimension::Y:
+        range.y_begin = MY + SYSTEM_EDGE_OFFSET;
+        range.y_end = range.y_begin + 1;
+        break;
+    case Dimension::Z:
+        range.z_begin = MZ + SYSTEM_EDGE_OFFSET;
+        range.z_end = range.z_begin + 1;
+        break;
+    default:
+        break;
     }
+
+    return range;
+}
+
+Lattice_accessor Lattice_accessor::cropped(const Range& range) const noexcept {
+    Lattice_accessor lattice = *this;
+
+    lattice.MX = range.x_end - range.x_begin;
+    if (dimensionality > 1)
+        lattice.MY = range.y_end - range.y_begin;
+    if (dimensionality > 2)
+        lattice.MZ = range.z_end - range.z_begin;
+
+    lattice.set_jumps();
+
+    return lattice;
+}
+
+void Lattice_accessor::skip_bounds(std::function<void(size_t, size_t, size_t)> function) noexcept {
+    for_each(inside(), [&function] (size_t x, size_t y, size_t z, size_t) { function(x, y, z); });
+}
+
+void Lattice_accessor::system_plus_bounds(std::function<void(size_t, size_t, size_t)> function) noexcept {
+    for_each(plus_bounds(), [&function] (size_t x, size_t y, size_t z, size_t) { function(x, y, z); });
 }
 
 size_t Lattice_accessor::index (const size_t x, const size_t y, const size_t z) noexcept {
@@ -88,73 +134,25 @@ size_t Lattice_accessor::index (const size_t x, const size_t y, const size_t z)
 
 
 void Lattice_accessor::x0_boundary(std::function<void(size_t, size_t, size_t)> function) noexcept {
-size_t x = 0, y = 0, z = 0;
-do {
-    z = 0;
-    do {
-        function(x,y,z);
-        ++z;
-        } while (z < MZ+BOUNDARIES);
-    ++y;
-    } while (y < MY+BOUNDARIES);   
+    for_each_in_memory_order(lower_boundary(Dimension::X), [&function] (size_t x, size_t y, size_t z, size_t) { function(x, y, z); });
 }
 
 void Lattice_accessor::xm_boundary(std::function<void(size_t, size_t, size_t)> function) noexcept {
-    size_t x = MX + SYSTEM_EDGE_OFFSET, y = 0, z = 0;
-    do {
-    z = 0;
-    do {
-        function(x,y,z);
-        ++z;
-    } while (z < MZ+BOUNDARIES);
-    ++y;
-    } while (y < MY+BOUNDARIES);
+    for_each_in_memory_order(upper_boundary(Dimension::X), [&function] (size_t x, size_t y, size_t z, size_t) { function(x, y, z); });
 }
 
 void Lattice_accessor::y0_boundary(std::function<void(size_t, size_t, size_t)> function) noexcept {
-    size_t x = 0, y = 0, z = 0;
-    do {
-        z = 0;
-        do {
-            function(x,y,z);
-            ++z;
-        } while (z < MZ+BOUNDARIES);
-    ++x;
-    } while (x < MX+BOUNDARIES);
+    for_each_in_memory_order(lower_boundary(Dimension::Y), [&function] (size_t x, size_t y, size_t z, size_t) { function(x, y, z); });
 }
 
 void Lattice_accessor::ym_boundary(std::function<void(size_t, size_t, size_t)> function) noexcept {
-    size_t x = 0, y = MY + SYSTEM_EDGE_OFFSET, z = 0;
-    do {
-        z = 0;
-        do {
-            function(x,y,z);
-            ++z;
-        } while (z < MZ+BOUNDARIES);
-        ++x;
-    } while (x < MX+BOUNDARIES);
+    for_each_in_memory_order(upper_boundary(Dimension::Y), [&function] (size_t x, size_t y, size_t z, size_t) { function(x, y, z); });
 }
 
 void Lattice_accessor::z0_boundary(std::function<void(size_t, size_t, size_t)> function) noexcept {
-    size_t x = 0, y = 0, z = 0;
-    do {
-        y = 0;
-        do {
-            function(x,y,z);
-            ++y;
-        } while (y < MY+BOUNDARIES);
-        ++x;
-    } while (x < MX+BOUNDARIES);
+    for_each_in_memory_order(lower_boundary(Dimension::Z), [&function] (size_t x, size_t y, size_t z, size_t) { function(x, y, z); });
 }
 
 void Lattice_accessor::zm_boundary(std::function<void(size_t, size_t, size_t)> function) noexcept {
-    size_t x = 0, y = 0, z = MZ + SYSTEM_EDGE_OFFSET;
-    do {
-        y = 0;
-        do {
-            function(x,y,z);
-            ++y;
-        } while (y < MY+BOUNDARIES);
-        ++x;
-    } while (x < MX+BOUNDARIES);
-}
\ No newline at end of file
+    for_each_in_memory_order(upper_boundary(Dimension::Z), [&function] (size_t x, size_t y, size_t z, size_t) { function(x, y, z); });
+}
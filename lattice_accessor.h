@@ -2,8 +2,14 @@
 #define LATTICE_ACCESSOR_H
 
 #include <unistd.h> //size_t
+#include <cstdint>
 #include <map>
 #include <functional>
+#include <vector>
+#include <algorithm>
+
+#include "thread_pool.h"
+#include "divider.h"
 
 enum class Dimension {
         X,
@@ -23,17 +29,29 @@ enum Dimensionality {
 class Lattice_accessor {
     static constexpr uint8_t SYSTEM_EDGE_OFFSET = 1;
     static constexpr uint8_t BOUNDARIES = 2;
-    typedef std::map<Dimension, size_t> Coordinate;
 
   public:
     Lattice_accessor();
 
+    //Lattice position, dimensions the lattice doesn't have are 0
+    struct Coordinate {
+        size_t x, y, z;
+
+        size_t& operator[](Dimension dimension) noexcept {
+            return dimension == Dimension::X ? x : dimension == Dimension::Y ? y : z;
+        }
+
+        size_t operator[](Dimension dimension) const noexcept {
+            return dimension == Dimension::X ? x : dimension == Dimension::Y ? y : z;
+        }
+    };
+
     size_t MX, MY, MZ;
     size_t system_size;
     //in lattice: gradients
     Dimensionality dimensionality;
 
-    const Coordinate coordinate(size_t index);
+    Coordinate coordinate(size_t index) const noexcept;
 
     void skip_bounds(std::function<void(size_t, size_t, size_t)> function) noexcept;
 
@@ -61,6 +79,83 @@ class Lattice_accessor {
 
     void set_jumps() noexcept;
 
+    //Box of lattice coordinates [x_begin, x_end) x [y_begin, y_end) x [z_begin, z_end)
+    struct Range {
+        size_t x_begin, x_end;
+        size_t y_begin, y_end;
+        size_t z_begin, z_end;
+    };
+
+    //Voxels visited by skip_bounds
+    Range inside() const noexcept;
+    //Voxels visited by system_plus_bounds
+    Range plus_bounds() const noexcept;
+    //Boundary planes at coordinate 0 and M+1 of a dimension, bounds of the other dimensions included
+    Range lower_boundary(Dimension) const noexcept;
+    Range upper_boundary(Dimension) const noexcept;
+
+    //Lattice of the same dimensionality whose interior is the range, e.g. for a part of a field read on its own.
+    //Dimensions the lattice doesn't have are left as they are.
+    Lattice_accessor cropped(const Range&) const noexcept;
+
+    /*
+     *  Inlined traversals: function(x, y, z, index) with index == index(x, y, z).
+     *  The index advances by the innermost stride instead of being recomputed, and strides that
+     *  are known for a dimensionality (e.g. jump_z = 1 in 3D) are compile time constants.
+     */
+
+    //z outermost, x innermost: the order of skip_bounds and system_plus_bounds
+    template<typename Function>
+    void for_each(const Range&, Function&&) const noexcept;
+
+    //x outermost, z innermost: the order of the boundary traversals, and of the data in memory
+    template<typename Function>
+    void for_each_in_memory_order(const Range&, Function&&) const noexcept;
+
+    //Block extents along x, y and z for the tiled traversals. The defaults keep whole z rows
+    //(unit stride in 3D) and limit y, so the three x planes a stencil reads stay in L2.
+    struct Tile {
+        size_t x = 16;
+        size_t y = 8;
+        size_t z = 1024;
+    };
+
+    //Calls block(const Range&) for every tile of the range, tiles in memory order
+    template<typename Function>
+    void for_each_block(const Range&, Function&&, Tile = Tile()) const noexcept;
+
+    //Memory order within each tile, tile by tile. Stencil kernels read neighbours at index +- jump_x/y/z,
+    //which then come from cache for all but the first plane of a tile.
+    template<typename Function>
+    void for_each_tiled(const Range&, Function&&, Tile = Tile()) const noexcept;
+
+    /*
+     *  Parallel traversals. The range is cut in blocks of whole z rows (runs along the innermost
+     *  dimension of memory order) and the blocks are spread over the pool, each visited in memory order.
+     *  Rows are never split, so a voxel's row is visited by one thread. A range that fits in a single block,
+     *  fewer than PARALLEL_BLOCK_SIZE voxels or one row, runs on the calling thread. 1D ranges have rows
+     *  of a single voxel, one per x, and are cut in blocks like any other.
+     */
+
+    //Rows per block are chosen to give blocks of about this many voxels
+    static constexpr size_t PARALLEL_BLOCK_SIZE = 1 << 15;
+
+    enum class Reduction {
+        //Blocks depend on the range only, so results are the same for any number of threads
+        DETERMINISTIC,
+        //One block per thread, fewer partial results but rounding depends on the thread count
+        PER_THREAD
+    };
+
+    //function(x, y, z, index) is called concurrently for different voxels, in no particular order.
+    template<typename Function>
+    void parallel_for_each(Thread_pool&, const Range&, Function&&) const;
+
+    //Every block starts from a copy of identity and calls function(accumulator&, x, y, z, index) for its voxels.
+    //Returns combine(...combine(combine(identity, block 0), block 1)..., last block), combining in block order.
+    template<typename T, typename Function, typename Combine>
+    T parallel_reduce(Thread_pool&, const Range&, T identity, Function&&, Combine&&, Reduction = Reduction::DETERMINISTIC) const;
+
     //in lattice: jump_x
     size_t jump_x;
     //in lattice: jump_y
@@ -69,6 +164,184 @@ class Lattice_accessor {
     size_t jump_z;
     //in lattice: M
 
+  private:
+    //Division by jump_x and jump_y, set by set_jumps
+    Divider m_divide_x;
+    Divider m_divide_y;
+
+    template<Dimensionality D> size_t stride_x() const noexcept { return D == one_D ? 1 : jump_x; }
+    template<Dimensionality D> size_t stride_y() const noexcept { return D == one_D ? 0 : D == two_D ? 1 : jump_y; }
+    template<Dimensionality D> size_t stride_z() const noexcept { return D == three_D ? 1 : 0; }
+
+    template<Dimensionality D, typename Function>
+    void z_major(const Range&, Function&) const noexcept;
+
+    //Rows first_row .. last_row-1 of the range, numbered in memory order
+    template<Dimensionality D, typename Function>
+    void x_major(const Range&, size_t first_row, size_t last_row, Function&) const noexcept;
+
+    template<typename Function>
+    void rows_in_memory_order(const Range&, size_t first_row, size_t last_row, Function&) const noexcept;
+
+    static size_t row_count(const Range&) noexcept;
+    static size_t rows_per_block(const Range&) noexcept;
 };
 
-#endif
\ No newline at end of file
+template<Dimensionality D, typename Function>
+void Lattice_accessor::z_major(const Range& range, Function& function) const noexcept {
+    for (size_t z = range.z_begin ; z < range.z_end ; ++z)
+        for (size_t y = range.y_begin ; y < range.y_end ; ++y) {
+            size_t index = range.x_begin*stride_x<D>() + y*stride_y<D>() + z*stride_z<D>();
+            for (size_t x = range.x_begin ; x < range.x_end ; ++x, index += stride_x<D>())
+                function(x, y, z, index);
+        }
+}
+
+template<Dimensionality D, typename Function>
+void Lattice_accessor::x_major(const Range& range, size_t first_row, size_t last_row, Function& function) const noexcept {
+    const size_t y_extent = range.y_end - range.y_begin;
+
+    if (first_row >= last_row)
+        return;
+
+    size_t x = range.x_begin + first_row / y_extent;
+    size_t y = range.y_begin + first_row % y_extent;
+
+    for (size_t row = first_row ; row < last_row ; ++row) {
+        size_t index = x*stride_x<D>() + y*stride_y<D>() + range.z_begin*stride_z<D>();
+        for (size_t z = range.z_begin ; z < range.z_end ; ++z, index += stride_z<D>())
+            function(x, y, z, index);
+
+        if (++y == range.y_end) {
+            y = range.y_begin;
+            ++x;
+        }
+    }
+}
+
+template<typename Function>
+void Lattice_accessor::rows_in_memory_order(const Range& range, size_t first_row, size_t last_row, Function& function) const noexcept {
+    switch (dimensionality) {
+    case one_D:
+        x_major<one_D>(range, first_row, last_row, function);
+        break;
+    case two_D:
+        x_major<two_D>(range, first_row, last_row, function);
+        break;
+    case three_D:
+        x_major<three_D>(range, first_row, last_row, function);
+        break;
+    }
+}
+
+template<typename Function>
+void Lattice_accessor::for_each(const Range& range, Function&& function) const noexcept {
+    switch (dimensionality) {
+    case one_D:
+        z_major<one_D>(range, function);
+        break;
+    case two_D:
+        z_major<two_D>(range, function);
+        break;
+    case three_D:
+        z_major<three_D>(range, function);
+        break;
+    }
+}
+
+template<typename Function>
+void Lattice_accessor::for_each_in_memory_order(const Range& range, Function&& function) const noexcept {
+    rows_in_memory_order(range, 0, row_count(range), function);
+}
+
+template<typename Function>
+void Lattice_accessor::for_each_block(const Range& range, Function&& block, Tile tile) const noexcept {
+    tile.x = std::max<size_t>(tile.x, 1);
+    tile.y = std::max<size_t>(tile.y, 1);
+    tile.z = std::max<size_t>(tile.z, 1);
+
+    for (size_t x = range.x_begin ; x < range.x_end ; x += tile.x)
+        for (size_t y = range.y_begin ; y < range.y_end ; y += tile.y)
+            for (size_t z = range.z_begin ; z < range.z_end ; z += tile.z)
+                block(Range{
+                    x, std::min(x + tile.x, range.x_end),
+                    y, std::min(y + tile.y, range.y_end),
+                    z, std::min(z + tile.z, range.z_end)
+                });
+}
+
+template<typename Function>
+void Lattice_accessor::for_each_tiled(const Range& range, Function&& function, Tile tile) const noexcept {
+    for_each_block(range,
+        [this, &function] (const Range& block) {
+            rows_in_memory_order(block, 0, row_count(block), function);
+        },
+        tile
+    );
+}
+
+inline size_t Lattice_accessor::row_count(const Range& range) noexcept {
+    if (range.z_end <= range.z_begin)
+        return 0;
+
+    return (range.x_end - range.x_begin) * (range.y_end - range.y_begin);
+}
+
+inline size_t Lattice_accessor::rows_per_block(const Range& range) noexcept {
+    const size_t row_length = range.z_end - range.z_begin;
+    return row_length >= PARALLEL_BLOCK_SIZE ? 1 : PARALLEL_BLOCK_SIZE / row_length;
+}
+
+template<typename Function>
+void Lattice_accessor::parallel_for_each(Thread_pool& pool, const Range& range, Function&& function) const {
+    const size_t rows = row_count(range);
+
+    if (rows == 0)
+        return;
+
+    const size_t block_rows = rows_per_block(range);
+
+    pool.parallel_for((rows + block_rows - 1) / block_rows,
+        [this, &range, &function, rows, block_rows] (size_t block) {
+            rows_in_memory_order(range, block * block_rows, std::min(rows, (block + 1) * block_rows), function);
+        }
+    );
+}
+
+template<typename T, typename Function, typename Combine>
+T Lattice_accessor::parallel_reduce(Thread_pool& pool, const Range& range, T identity, Function&& function, Combine&& combine, Reduction reduction) const {
+    const size_t rows = row_count(range);
+
+    if (rows == 0)
+        return identity;
+
+    size_t block_rows = rows_per_block(range);
+
+    if (reduction == Reduction::PER_THREAD)
+        block_rows = (rows + pool.size() - 1) / pool.size();
+
+    std::vector<T> partials((rows + block_rows - 1) / block_rows, identity);
+
+    pool.parallel_for(partials.size(),
+        [this, &range, &function, &partials, &identity, rows, block_rows] (size_t block) {
+            //Accumulate locally, neighbouring partials share cache lines
+            T accumulator = identity;
+
+            auto accumulate = [&function, &accumulator] (size_t x, size_t y, size_t z, size_t index) {
+                function(accumulator, x, y, z, index);
+            };
+
+            rows_in_memory_order(range, block * block_rows, std::min(rows, (block + 1) * block_rows), accumulate);
+            partials[block] = std::move(accumulator);
+        }
+    );
+
+    T result = std::move(identity);
+
+    for (T& partial : partials)
+        result = combine(std::move(result), partial);
+
+    return result;
+}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef LATTICE_CONTAINER_H
+#define LATTICE_CONTAINER_H
+
+#include "lattice_accessor.h"
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ *  Native .nlc container: components of a lattice as raw doubles that are mapped and used in place.
+ *
+ *  Native byte order, written by Container_writer and read by Container_reader:
+ *      header      Lattice_container::Header
+ *      names       component names, each followed by '\0', at names_offset
+ *      index       components * chunks_per_component Lattice_container::Chunk, component after component
+ *      data        one block per chunk, each starting at a multiple of ALIGNMENT
+ *
+ *  A chunk holds the voxels of a box of lattice coordinates in memory order (x outermost, the last dimension
+ *  innermost). Untiled files have one chunk per component; with bounds that chunk is exactly the namics array of
+ *  the lattice, without bounds it holds the interior only. Tiled files cut the stored voxels in tiles of
+ *  tile_x * tile_y * tile_z, so a part of the lattice can be read without touching the rest.
+ *  Coordinates of dimensions the lattice doesn't have are [0, 1).
+ */
+
+namespace Lattice_container {
+
+    constexpr char MAGIC[8] = {'N', 'M', 'L', 'A', 'T', 'T', 'C', '\0'};
+    constexpr uint32_t VERSION = 1;
+    //Reads back as another value on a machine of the other byte order
+    constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+    //Data blocks start at page boundaries, so every block can be mapped on its own
+    constexpr size_t ALIGNMENT = 4096;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint32_t dimensionality;
+        //Chunks hold bounds, at coordinates 0 and M+1
+        uint32_t with_bounds;
+        uint64_t MX, MY, MZ;
+        uint64_t components;
+        //0 when components are not tiled
+        uint64_t tile_x, tile_y, tile_z;
+        uint64_t chunks_per_component;
+        uint64_t names_offset;
+        uint64_t names_size;
+        uint64_t index_offset;
+    };
+
+    struct Chunk {
+        uint64_t x_begin, x_end;
+        uint64_t y_begin, y_end;
+        uint64_t z_begin, z_end;
+        //Byte offset of the values in the file
+        uint64_t offset;
+        uint64_t values;
+    };
+
+    inline size_t aligned(size_t offset, size_t alignment = ALIGNMENT) noexcept {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    //Voxels stored per component, dimensions the lattice doesn't have set to [0, 1)
+    inline Lattice_accessor::Range stored_range(const Lattice_accessor& lattice, bool with_bounds) noexcept {
+        Lattice_accessor::Range range = with_bounds ? lattice.plus_bounds() : lattice.inside();
+
+        if (lattice.dimensionality < 2) {
+            range.y_begin = 0;
+            range.y_end = 1;
+        }
+
+        if (lattice.dimensionality < 3) {
+            range.z_begin = 0;
+            range.z_end = 1;
+        }
+
+        return range;
+    }
+
+    //Calls run(index, count, first) for the runs of a box along the innermost dimension, in memory order: count
+    //voxels from lattice index index on, which are values first .. first+count-1 of the box in memory order.
+    template<typename Function>
+    void for_each_run(const Lattice_accessor& lattice, const Lattice_accessor::Range& box, Function&& run) {
+        size_t first = 0;
+
+        switch (lattice.dimensionality) {
+        case one_D:
+            run(lattice.index(box.x_begin, 0, 0), box.x_end - box.x_begin, first);
+            break;
+        case two_D:
+            for (size_t x = box.x_begin ; x < box.x_end ; ++x, first += box.y_end - box.y_begin)
+                run(lattice.index(x, box.y_begin, 0), box.y_end - box.y_begin, first);
+            break;
+        case three_D:
+            for (size_t x = box.x_begin ; x < box.x_end ; ++x)
+                for (size_t y = box.y_begin ; y < box.y_end ; ++y, first += box.z_end - box.z_begin)
+                    run(lattice.index(x, y, box.z_begin), box.z_end - box.z_begin, first);
+            break;
+        }
+    }
+}
+
+#endif
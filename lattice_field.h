@@ -0,0 +1,180 @@
+#ifndef LATTICE_FIELD_H
+#define LATTICE_FIELD_H
+
+#include "lattice_accessor.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <sys/mman.h>
+
+/*
+ *  A scalar field on a lattice, owning its storage.
+ *
+ *  Values are laid out exactly as Lattice_accessor indexes them, bounds included: the bounds are the
+ *  halo around the interior. Storage is 64 byte aligned (a cache line, and wide enough for any SIMD load)
+ *  and zero initialized. Fields are move-only, so they can be handed from reader to expander to writer
+ *  without copying; data() is what IOutput_ptr and SIMD kernels work on.
+ */
+
+template<typename T>
+class Lattice_field {
+    static_assert(std::is_trivially_copyable<T>::value, "Lattice_field holds plain numbers");
+
+  public:
+    static constexpr size_t ALIGNMENT = 64;
+    static constexpr size_t HUGE_PAGE_SIZE = size_t{1} << 21;
+
+    enum class Pages {
+        DEFAULT,
+        //Transparent huge pages, for large fields traversed repeatedly. Falls back to normal pages.
+        HUGE_PAGES
+    };
+
+    //Interior without bounds: (0, 0, 0) is the first voxel inside the bounds
+    template<typename U>
+    struct View {
+        U* origin;
+        size_t extent_x, extent_y, extent_z;
+        size_t stride_x, stride_y, stride_z;
+
+        U& operator()(size_t x, size_t y, size_t z) const noexcept {
+            return origin[x*stride_x + y*stride_y + z*stride_z];
+        }
+    };
+
+    Lattice_field() noexcept
+    : m_data{nullptr}, m_size{0}, m_bytes{0}, m_mapped{false}
+    { }
+
+    explicit Lattice_field(const Lattice_accessor& geometry_, Pages pages_ = Pages::DEFAULT)
+    : m_geometry{geometry_}, m_data{nullptr}, m_size{geometry_.system_size}, m_bytes{0}, m_mapped{false}
+    {
+        allocate(pages_);
+    }
+
+    Lattice_field(const Lattice_field&) = delete;
+    Lattice_field& operator=(const Lattice_field&) = delete;
+
+    Lattice_field(Lattice_field&& other) noexcept
+    : m_geometry{other.m_geometry}, m_data{other.m_data}, m_size{other.m_size}, m_bytes{other.m_bytes}, m_mapped{other.m_mapped}
+    {
+        other.m_data = nullptr;
+        other.m_size = 0;
+        other.m_bytes = 0;
+    }
+
+    Lattice_field& operator=(Lattice_field&& other) noexcept {
+        if (this != &other) {
+            release();
+            m_geometry = other.m_geometry;
+            m_data = other.m_data;
+            m_size = other.m_size;
+            m_bytes = other.m_bytes;
+            m_mapped = other.m_mapped;
+            other.m_data = nullptr;
+            other.m_size = 0;
+            other.m_bytes = 0;
+        }
+
+        return *this;
+    }
+
+    ~Lattice_field() {
+        release();
+    }
+
+    const Lattice_accessor& geometry() const noexcept { return m_geometry; }
+
+    size_t size() const noexcept { return m_size; }
+
+    T* data() noexcept { return m_data; }
+    const T* data() const noexcept { return m_data; }
+
+    T* begin() noexcept { return m_data; }
+    T* end() noexcept { return m_data + m_size; }
+    const T* begin() const noexcept { return m_data; }
+    const T* end() const noexcept { return m_data + m_size; }
+
+    T& operator[](size_t index) noexcept { return m_data[index]; }
+    const T& operator[](size_t index) const noexcept { return m_data[index]; }
+
+    T& operator()(size_t x, size_t y, size_t z) noexcept { return m_data[m_geometry.index(x, y, z)]; }
+    const T& operator()(size_t x, size_t y, size_t z) const noexcept { return m_data[m_geometry.index(x, y, z)]; }
+
+    size_t jump_x() const noexcept { return m_geometry.jump_x; }
+    size_t jump_y() const noexcept { return m_geometry.jump_y; }
+    size_t jump_z() const noexcept { return m_geometry.jump_z; }
+
+    View<T> interior() noexcept {
+        return interior_view<T>(m_data);
+    }
+
+    View<const T> interior() const noexcept {
+        return interior_view<const T>(m_data);
+    }
+
+  private:
+    Lattice_accessor m_geometry;
+    T* m_data;
+    size_t m_size;
+    //Bytes allocated, rounded up to ALIGNMENT (or HUGE_PAGE_SIZE when mapped)
+    size_t m_bytes;
+    bool m_mapped;
+
+    template<typename U>
+    View<U> interior_view(U* data) const noexcept {
+        const Lattice_accessor::Range inside = m_geometry.inside();
+        return {
+            data + m_geometry.index(inside.x_begin, inside.y_begin, inside.z_begin),
+            inside.x_end - inside.x_begin, inside.y_end - inside.y_begin, inside.z_end - inside.z_begin,
+            m_geometry.jump_x, m_geometry.jump_y, m_geometry.jump_z
+        };
+    }
+
+    void allocate(Pages pages) {
+        if (m_size == 0)
+            return;
+
+        m_bytes = (m_size * sizeof(T) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+        if (pages == Pages::HUGE_PAGES and m_bytes >= HUGE_PAGE_SIZE) {
+            const size_t bytes = (m_bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+            void* mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (mapping != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+                madvise(mapping, bytes, MADV_HUGEPAGE);
+#endif
+                //Anonymous mappings are zero filled
+                m_data = static_cast<T*>(mapping);
+                m_bytes = bytes;
+                m_mapped = true;
+                return;
+            }
+        }
+
+        void* memory = nullptr;
+
+        if (posix_memalign(&memory, ALIGNMENT, m_bytes) != 0)
+            throw std::bad_alloc();
+
+        memset(memory, 0, m_bytes);
+        m_data = static_cast<T*>(memory);
+    }
+
+    void release() noexcept {
+        if (m_data == nullptr)
+            return;
+
+        if (m_mapped)
+            munmap(m_data, m_bytes);
+        else
+            free(m_data);
+
+        m_data = nullptr;
+    }
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include "line_scanner.h"
+
+Line_scanner::Line_scanner(std::istream& stream, size_t buffer_size)
+    : m_stream{stream}, m_buffer(buffer_size), m_position{0}, m_filled{0}, m_exhausted{false}
+{
+}
+
+bool Line_scanner::refill()
+{
+    if (m_exhausted)
+        return false;
+
+    //Keep the unfinished line, move it to the front.
+    size_t remaining = m_filled - m_position;
+    if (remaining > 0 and m_position > 0)
+        memmove(m_buffer.data(), m_buffer.data() + m_position, remaining);
+
+    m_position = 0;
+    m_filled = remaining;
+
+    if (m_filled == m_buffer.size())
+        m_buffer.resize(m_buffer.size() * 2);
+
+    m_stream.read(m_buffer.data() + m_filled, m_buffer.size() - m_filled);
+    size_t read = static_cast<size_t>(m_stream.gcount());
+    m_filled += read;
+
+    if (read == 0)
+        m_exhausted = true;
+
+    return read > 0;
+}
+
+bool Line_scanner::next_line(Line& line)
+{
+    size_t searched = m_position;
+
+    for (;;)
+    {
+        const char* newline = static_cast<const char*>(
+            memchr(m_buffer.data() + searched, '\n', m_filled - searched)
+        );
+
+        if (newline)
+        {
+            line.begin = m_buffer.data() + m_position;
+            line.end = newline;
+            m_position = newline - m_buffer.data() + 1;
+            break;
+        }
+
+        size_t offset = m_filled - m_position;
+
+        if (not refill())
+        {
+            //Last line without a trailing newline
+            if (m_position == m_filled)
+                return false;
+
+            line.begin = m_buffer.data() + m_position;
+            line.end = m_buffer.data() + m_filled;
+            m_position = m_filled;
+            break;
+        }
+
+        searched = m_position + offset;
+    }
+
+    if (line.end != line.begin and *(line.end - 1) == '\r')
+        --line.end;
+
+    return true;
+}
@@ -0,0 +1,42 @@
+#ifndef LINE_SCANNER_H
+#define LINE_SCANNER_H
+
+#include <istream>
+#include <vector>
+#include <cstring>
+
+//Hands out lines of a stream in place, straight from a large read buffer.
+//Lines stay valid until the next call to next_line. No allocations after construction,
+//unless a single line is longer than the buffer.
+class Line_scanner {
+    public:
+        explicit Line_scanner(std::istream& stream, size_t buffer_size = DEFAULT_BUFFER_SIZE);
+
+        static constexpr size_t DEFAULT_BUFFER_SIZE = 1 << 22;
+
+        struct Line {
+            const char* begin;
+            const char* end;
+
+            bool starts_with(const char* prefix) const noexcept {
+                size_t length = strlen(prefix);
+                return static_cast<size_t>(end - begin) >= length and memcmp(begin, prefix, length) == 0;
+            }
+
+            bool empty() const noexcept { return begin == end; }
+        };
+
+        //Returns false once the stream is exhausted. Strips '\n' and '\r\n'.
+        bool next_line(Line& line);
+
+    private:
+        std::istream& m_stream;
+        std::vector<char> m_buffer;
+        size_t m_position;
+        size_t m_filled;
+        bool m_exhausted;
+
+        bool refill();
+};
+
+#endif
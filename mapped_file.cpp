@@ -0,0 +1,139 @@
+#include "mapped_file.h"
+#include "queued_io.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Mapped_file::Mapped_file(const std::string& filename, Source source_)
+    : m_filename{filename}, m_fd{-1}, m_begin{nullptr}, m_size{0}, m_source{source_}, m_tail{0}, m_loaded{0}, m_failed{false}
+{
+    m_fd = open(filename.c_str(), O_RDONLY);
+
+    if (m_fd == -1)
+    {
+        std::cerr << "Could not open " << filename << " for mapping." << std::endl;
+        throw ERROR_OPEN;
+    }
+
+    struct stat status;
+    if (fstat(m_fd, &status) == -1)
+    {
+        close(m_fd);
+        std::cerr << "Could not stat " << filename << "." << std::endl;
+        throw ERROR_OPEN;
+    }
+
+    m_size = static_cast<size_t>(status.st_size);
+
+    //mmap refuses zero-length mappings, an empty range will do.
+    if (m_size == 0)
+        return;
+
+    if (m_source != Source::MAP)
+    {
+        void* buffer = nullptr;
+
+        if (posix_memalign(&buffer, Queued_io::ALIGNMENT, m_size) != 0)
+        {
+            close(m_fd);
+            std::cerr << "Could not allocate " << m_size << " bytes for " << filename << "." << std::endl;
+            throw ERROR_READ;
+        }
+
+        //The last request first, readers start with the last line
+        if (m_source == Source::QUEUED_READ_AHEAD)
+            m_tail = (m_size - 1) / Queued_io::REQUEST_SIZE * Queued_io::REQUEST_SIZE;
+
+        if (not Queued_io::read(m_fd, static_cast<char*>(buffer) + m_tail, m_size - m_tail, m_tail))
+        {
+            free(buffer);
+            close(m_fd);
+            std::cerr << "Could not read " << filename << "." << std::endl;
+            throw ERROR_READ;
+        }
+
+        m_begin = static_cast<const char*>(buffer);
+
+        if (m_tail > 0)
+            m_loader = std::thread(&Mapped_file::read_ahead, this);
+
+        return;
+    }
+
+    void* address = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+
+    if (address == MAP_FAILED)
+    {
+        close(m_fd);
+        std::cerr << "Could not map " << filename << " into memory." << std::endl;
+        throw ERROR_MAP;
+    }
+
+    //We only ever walk through these files front to back.
+    madvise(address, m_size, MADV_SEQUENTIAL);
+
+    m_begin = static_cast<const char*>(address);
+}
+
+void Mapped_file::read_ahead()
+{
+    const bool read = Queued_io::read(m_fd, const_cast<char*>(m_begin), m_tail, 0, [this] (size_t loaded) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_loaded.store(loaded, std::memory_order_release);
+        }
+
+        m_condition.notify_all();
+    });
+
+    if (not read)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_failed = true;
+        }
+
+        m_condition.notify_all();
+    }
+}
+
+void Mapped_file::wait_for(const char* first, const char* last) const
+{
+    const size_t from = first - m_begin;
+    const size_t to = last - m_begin;
+
+    auto in_memory = [this, from, to] {
+        return from >= m_tail or std::min(to, m_tail) <= m_loaded.load(std::memory_order_acquire);
+    };
+
+    if (in_memory())
+        return;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this, &in_memory] { return in_memory() or m_failed; });
+
+    if (not in_memory())
+    {
+        std::cerr << "Could not read " << m_filename << "." << std::endl;
+        throw ERROR_READ;
+    }
+}
+
+Mapped_file::~Mapped_file()
+{
+    if (m_loader.joinable())
+        m_loader.join();
+
+    if (m_begin and m_source != Source::MAP)
+        free(const_cast<char*>(m_begin));
+    else if (m_begin)
+        munmap(const_cast<char*>(m_begin), m_size);
+
+    if (m_fd != -1)
+        close(m_fd);
+}
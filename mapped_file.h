@@ -0,0 +1,63 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+//Read-only memory mapping of a whole file. Unmapped on destruction.
+class Mapped_file {
+    public:
+        enum class Source {
+            MAP,
+            //Read into memory with queued requests instead (queued_io.h), where faulting in a mapping page by
+            //page is slow, e.g. on parallel filesystems
+            QUEUED_READ,
+            //As QUEUED_READ, but only the last request is read before the constructor returns. The rest arrives
+            //front to back in the background, wait_for() the bytes before looking at them.
+            QUEUED_READ_AHEAD
+        };
+
+        explicit Mapped_file(const std::string& filename, Source source = Source::MAP);
+        ~Mapped_file();
+
+        Mapped_file(const Mapped_file&) = delete;
+        Mapped_file& operator=(const Mapped_file&) = delete;
+
+        enum error {
+            ERROR_OPEN,
+            ERROR_MAP,
+            ERROR_READ
+        };
+
+        const char* begin() const noexcept { return m_begin; }
+        const char* end() const noexcept { return m_begin + m_size; }
+        size_t size() const noexcept { return m_size; }
+
+        //Blocks until [first, last) is in memory. Throws ERROR_READ if reading it failed.
+        void wait_for(const char* first, const char* last) const;
+        //Everything is in memory already
+        bool loaded() const noexcept { return m_loaded.load(std::memory_order_acquire) >= m_tail; }
+
+    private:
+        const std::string m_filename;
+        int m_fd;
+        const char* m_begin;
+        size_t m_size;
+        const Source m_source;
+
+        //Bytes from m_tail on were read by the constructor, those before m_loaded since
+        size_t m_tail;
+        std::atomic<size_t> m_loaded;
+        bool m_failed;
+        mutable std::mutex m_mutex;
+        mutable std::condition_variable m_condition;
+        std::thread m_loader;
+
+        void read_ahead();
+};
+
+#endif
@@ -0,0 +1,561 @@
+#include "number_formatter.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+namespace {
+
+    //Scaling by 10^27 is exact in a 64 bit mantissa (5^27 < 2^64)
+    constexpr int MAX_FAST_PRECISION = 15;
+    constexpr int MAX_EXACT_POWER = 27;
+    //Scaling error is below 1e-4 units in the last digit, anything closer to a tie goes to snprintf
+    constexpr long double TIE_MARGIN = 1e-3L;
+    constexpr int MAX_PRECISION = 17;
+    constexpr bool HAS_EXTENDED_PRECISION = std::numeric_limits<long double>::digits >= 64;
+
+    constexpr long double powers_of_ten[MAX_EXACT_POWER + 1] = {
+        1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L, 1e10L, 1e11L, 1e12L, 1e13L,
+        1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L, 1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L
+    };
+
+    constexpr uint64_t integer_powers_of_ten[MAX_FAST_PRECISION + 1] = {
+        1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+        1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+        100000000000000ull, 1000000000000000ull
+    };
+
+    size_t format_with_printf(double value, int precision, char* output)
+    {
+        return snprintf(output, Number_formatter::MAX_LENGTH, "%.*g", precision, value);
+    }
+
+    bool scale(long double magnitude, int exponent, int precision, long double& scaled)
+    {
+        int power = precision - 1 - exponent;
+
+        if (power > MAX_EXACT_POWER or power < -MAX_EXACT_POWER)
+            return false;
+
+        scaled = power >= 0 ? magnitude * powers_of_ten[power] : magnitude / powers_of_ten[-power];
+        return true;
+    }
+
+    size_t write_exponent(int exponent, char* output)
+    {
+        size_t length = 0;
+        output[length++] = 'e';
+        output[length++] = exponent < 0 ? '-' : '+';
+
+        unsigned magnitude = exponent < 0 ? -exponent : exponent;
+
+        if (magnitude >= 100)
+            output[length++] = '0' + magnitude / 100;
+
+        output[length++] = '0' + (magnitude / 10) % 10;
+        output[length++] = '0' + magnitude % 10;
+
+        return length;
+    }
+
+    //Lays out digits d.ddd x 10^exponent the way %g does at the given precision
+    size_t write_significand(const char* significand, int significant, int exponent, int precision, char* output)
+    {
+        size_t length = 0;
+
+        if (exponent < -4 or exponent >= precision)
+        {
+            output[length++] = significand[0];
+
+            if (significant > 1)
+            {
+                output[length++] = '.';
+                for (int i = 1; i < significant; ++i)
+                    output[length++] = significand[i];
+            }
+
+            return length + write_exponent(exponent, output + length);
+        }
+
+        if (exponent < 0)
+        {
+            output[length++] = '0';
+            output[length++] = '.';
+
+            for (int i = -1; i > exponent; --i)
+                output[length++] = '0';
+
+            for (int i = 0; i < significant; ++i)
+                output[length++] = significand[i];
+
+            return length;
+        }
+
+        for (int i = 0; i <= exponent; ++i)
+            output[length++] = i < significant ? significand[i] : '0';
+
+        if (significant > exponent + 1)
+        {
+            output[length++] = '.';
+            for (int i = exponent + 1; i < significant; ++i)
+                output[length++] = significand[i];
+        }
+
+        return length;
+    }
+
+    /*
+     *  Grisu3 (Loitsch, "Printing floating-point numbers quickly and accurately with integers", 2010).
+     *  Produces the shortest, closest digit string within the rounding interval of the value, or reports
+     *  that the multiplication error keeps it from knowing (about 0.5% of random doubles). Those values go
+     *  to an exact search. Floats are handled by computing the interval from the float mantissa, the
+     *  arithmetic is the same.
+     */
+
+    struct Diy_fp {
+        uint64_t f;
+        int e;
+    };
+
+    Diy_fp subtract(Diy_fp x, Diy_fp y)
+    {
+        return {x.f - y.f, x.e};
+    }
+
+    //Upper 64 bits of the product, rounded
+    Diy_fp multiply(Diy_fp x, Diy_fp y)
+    {
+        const unsigned __int128 product = static_cast<unsigned __int128>(x.f) * y.f;
+        uint64_t high = static_cast<uint64_t>(product >> 64);
+        high += static_cast<uint64_t>(product) >> 63;
+        return {high, x.e + y.e + 64};
+    }
+
+    Diy_fp normalize(Diy_fp x)
+    {
+        const int shift = __builtin_clzll(x.f);
+        return {x.f << shift, x.e - shift};
+    }
+
+    Diy_fp normalize_to(Diy_fp x, int exponent)
+    {
+        return {x.f << (x.e - exponent), exponent};
+    }
+
+    //Value with the lower and upper bounds of its rounding interval, normalized to a common exponent
+    struct Boundaries {
+        Diy_fp w;
+        Diy_fp minus;
+        Diy_fp plus;
+    };
+
+    template<typename T, typename Bits>
+    Boundaries boundaries(T value)
+    {
+        constexpr int precision = std::numeric_limits<T>::digits;
+        constexpr int bias = std::numeric_limits<T>::max_exponent - 1 + (precision - 1);
+        constexpr int min_exponent = 1 - bias;
+        constexpr uint64_t hidden_bit = uint64_t{1} << (precision - 1);
+
+        Bits bits;
+        memcpy(&bits, &value, sizeof(T));
+
+        const uint64_t biased_exponent = bits >> (precision - 1);
+        const uint64_t fraction = bits & (hidden_bit - 1);
+
+        const Diy_fp v = biased_exponent == 0
+            ? Diy_fp{fraction, min_exponent}
+            : Diy_fp{fraction + hidden_bit, static_cast<int>(biased_exponent) - bias};
+
+        //At a power of two the next lower value is only half as far away
+        const bool lower_is_closer = fraction == 0 and biased_exponent > 1;
+
+        const Diy_fp plus = normalize({2 * v.f + 1, v.e - 1});
+        const Diy_fp minus = lower_is_closer ? Diy_fp{4 * v.f - 1, v.e - 2} : Diy_fp{2 * v.f - 1, v.e - 1};
+
+        return {normalize(v), normalize_to(minus, plus.e), plus};
+    }
+
+    struct Cached_power {
+        uint64_t f;
+        int e;
+        int k;
+    };
+
+    //10^k for k = -300, -292, ... 324, rounded to 64 bits
+    constexpr Cached_power cached_powers[] = {
+        { 0xAB70FE17C79AC6CA, -1060,  -300 },
+        { 0xFF77B1FCBEBCDC4F, -1034,  -292 },
+        { 0xBE5691EF416BD60C, -1007,  -284 },
+        { 0x8DD01FAD907FFC3C,  -980,  -276 },
+        { 0xD3515C2831559A83,  -954,  -268 },
+        { 0x9D71AC8FADA6C9B5,  -927,  -260 },
+        { 0xEA9C227723EE8BCB,  -901,  -252 },
+        { 0xAECC49914078536D,  -874,  -244 },
+        { 0x823C12795DB6CE57,  -847,  -236 },
+        { 0xC21094364DFB5637,  -821,  -228 },
+        { 0x9096EA6F3848984F,  -794,  -220 },
+        { 0xD77485CB25823AC7,  -768,  -212 },
+        { 0xA086CFCD97BF97F4,  -741,  -204 },
+        { 0xEF340A98172AACE5,  -715,  -196 },
+        { 0xB23867FB2A35B28E,  -688,  -188 },
+        { 0x84C8D4DFD2C63F3B,  -661,  -180 },
+        { 0xC5DD44271AD3CDBA,  -635,  -172 },
+        { 0x936B9FCEBB25C996,  -608,  -164 },
+        { 0xDBAC6C247D62A584,  -582,  -156 },
+        { 0xA3AB66580D5FDAF6,  -555,  -148 },
+        { 0xF3E2F893DEC3F126,  -529,  -140 },
+        { 0xB5B5ADA8AAFF80B8,  -502,  -132 },
+        { 0x87625F056C7C4A8B,  -475,  -124 },
+        { 0xC9BCFF6034C13053,  -449,  -116 },
+        { 0x964E858C91BA2655,  -422,  -108 },
+        { 0xDFF9772470297EBD,  -396,  -100 },
+        { 0xA6DFBD9FB8E5B88F,  -369,   -92 },
+        { 0xF8A95FCF88747D94,  -343,   -84 },
+        { 0xB94470938FA89BCF,  -316,   -76 },
+        { 0x8A08F0F8BF0F156B,  -289,   -68 },
+        { 0xCDB02555653131B6,  -263,   -60 },
+        { 0x993FE2C6D07B7FAC,  -236,   -52 },
+        { 0xE45C10C42A2B3B06,  -210,   -44 },
+        { 0xAA242499697392D3,  -183,   -36 },
+        { 0xFD87B5F28300CA0E,  -157,   -28 },
+        { 0xBCE5086492111AEB,  -130,   -20 },
+        { 0x8CBCCC096F5088CC,  -103,   -12 },
+        { 0xD1B71758E219652C,   -77,    -4 },
+        { 0x9C40000000000000,   -50,     4 },
+        { 0xE8D4A51000000000,   -24,    12 },
+        { 0xAD78EBC5AC620000,     3,    20 },
+        { 0x813F3978F8940984,    30,    28 },
+        { 0xC097CE7BC90715B3,    56,    36 },
+        { 0x8F7E32CE7BEA5C70,    83,    44 },
+        { 0xD5D238A4ABE98068,   109,    52 },
+        { 0x9F4F2726179A2245,   136,    60 },
+        { 0xED63A231D4C4FB27,   162,    68 },
+        { 0xB0DE65388CC8ADA8,   189,    76 },
+        { 0x83C7088E1AAB65DB,   216,    84 },
+        { 0xC45D1DF942711D9A,   242,    92 },
+        { 0x924D692CA61BE758,   269,   100 },
+        { 0xDA01EE641A708DEA,   295,   108 },
+        { 0xA26DA3999AEF774A,   322,   116 },
+        { 0xF209787BB47D6B85,   348,   124 },
+        { 0xB454E4A179DD1877,   375,   132 },
+        { 0x865B86925B9BC5C2,   402,   140 },
+        { 0xC83553C5C8965D3D,   428,   148 },
+        { 0x952AB45CFA97A0B3,   455,   156 },
+        { 0xDE469FBD99A05FE3,   481,   164 },
+        { 0xA59BC234DB398C25,   508,   172 },
+        { 0xF6C69A72A3989F5C,   534,   180 },
+        { 0xB7DCBF5354E9BECE,   561,   188 },
+        { 0x88FCF317F22241E2,   588,   196 },
+        { 0xCC20CE9BD35C78A5,   614,   204 },
+        { 0x98165AF37B2153DF,   641,   212 },
+        { 0xE2A0B5DC971F303A,   667,   220 },
+        { 0xA8D9D1535CE3B396,   694,   228 },
+        { 0xFB9B7CD9A4A7443C,   720,   236 },
+        { 0xBB764C4CA7A44410,   747,   244 },
+        { 0x8BAB8EEFB6409C1A,   774,   252 },
+        { 0xD01FEF10A657842C,   800,   260 },
+        { 0x9B10A4E5E9913129,   827,   268 },
+        { 0xE7109BFBA19C0C9D,   853,   276 },
+        { 0xAC2820D9623BF429,   880,   284 },
+        { 0x80444B5E7AA7CF85,   907,   292 },
+        { 0xBF21E44003ACDD2D,   933,   300 },
+        { 0x8E679C2F5E44FF8F,   960,   308 },
+        { 0xD433179D9C8CB841,   986,   316 },
+        { 0x9E19DB92B4E31BA9,  1013,   324 }
+    };
+
+    constexpr int CACHED_POWERS_MIN_EXPONENT = -300;
+    constexpr int CACHED_POWERS_STEP = 8;
+
+    //Scaled exponents land in [ALPHA, GAMMA], so the integral part fits 32 bits
+    constexpr int ALPHA = -60;
+    constexpr int GAMMA = -32;
+
+    Cached_power cached_power_for(int binary_exponent)
+    {
+        //ceil((ALPHA - e - 1) * log10(2))
+        const int f = ALPHA - binary_exponent - 1;
+        const int k = (f * 78913) / (1 << 18) + (f > 0);
+        const int index = (-CACHED_POWERS_MIN_EXPONENT + k + (CACHED_POWERS_STEP - 1)) / CACHED_POWERS_STEP;
+
+        return cached_powers[index];
+    }
+
+    int largest_power_of_ten(uint32_t n, uint32_t& power)
+    {
+        static constexpr uint32_t powers[] = {
+            1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+        };
+
+        int digits = 10;
+        while (digits > 1 and n < powers[digits - 1])
+            --digits;
+
+        power = powers[digits - 1];
+        return digits;
+    }
+
+    //Moves the last digit towards w while that stays inside the unsafe interval. False when, within the
+    //multiplication error of unit, the digits may lie outside the rounding interval or not be the closest.
+    bool round_weed(char* digits, int length, uint64_t distance_too_high_w, uint64_t unsafe_interval, uint64_t rest, uint64_t ten_k, uint64_t unit)
+    {
+        const uint64_t small_distance = distance_too_high_w - unit;
+        const uint64_t big_distance = distance_too_high_w + unit;
+
+        while (rest < small_distance and unsafe_interval - rest >= ten_k
+               and (rest + ten_k < small_distance or small_distance - rest >= rest + ten_k - small_distance))
+        {
+            --digits[length - 1];
+            rest += ten_k;
+        }
+
+        //Within the error, one digit lower could be closer to w as well
+        if (rest < big_distance and unsafe_interval - rest >= ten_k
+            and (rest + ten_k < big_distance or big_distance - rest > rest + ten_k - big_distance))
+            return false;
+
+        return 2 * unit <= rest and rest <= unsafe_interval - 4 * unit;
+    }
+
+    //Digits of the shortest number in (minus, plus) widened by the multiplication error, value is
+    //digits * 10^decimal_exponent. False when they can't be proven to be the shortest inside (minus, plus),
+    //length then still tells how many digits the widened interval needs at least.
+    bool generate_digits(char* digits, int& length, int& decimal_exponent, Diy_fp minus, Diy_fp w, Diy_fp plus)
+    {
+        uint64_t unit = 1;
+        const Diy_fp too_low = {minus.f - unit, minus.e};
+        const Diy_fp too_high = {plus.f + unit, plus.e};
+        uint64_t unsafe_interval = subtract(too_high, too_low).f;
+
+        const Diy_fp one = {uint64_t{1} << -w.e, w.e};
+
+        uint32_t integral = static_cast<uint32_t>(too_high.f >> -one.e);
+        uint64_t fractional = too_high.f & (one.f - 1);
+
+        length = 0;
+        uint32_t power;
+        int remaining = largest_power_of_ten(integral, power);
+
+        while (remaining > 0)
+        {
+            digits[length++] = '0' + integral / power;
+            integral %= power;
+            --remaining;
+
+            const uint64_t rest = (static_cast<uint64_t>(integral) << -one.e) + fractional;
+            if (rest < unsafe_interval)
+            {
+                decimal_exponent += remaining;
+                return round_weed(digits, length, subtract(too_high, w).f, unsafe_interval, rest, static_cast<uint64_t>(power) << -one.e, unit);
+            }
+
+            power /= 10;
+        }
+
+        for (;;)
+        {
+            fractional *= 10;
+            unit *= 10;
+            unsafe_interval *= 10;
+            digits[length++] = '0' + (fractional >> -one.e);
+            fractional &= one.f - 1;
+            --decimal_exponent;
+
+            if (fractional < unsafe_interval)
+                return round_weed(digits, length, subtract(too_high, w).f * unit, unsafe_interval, fractional, one.f, unit);
+        }
+    }
+
+    bool grisu3(const Boundaries& value, char* digits, int& length, int& decimal_exponent)
+    {
+        const Cached_power cached = cached_power_for(value.plus.e);
+        const Diy_fp c = {cached.f, cached.e};
+
+        const Diy_fp w = multiply(value.w, c);
+        const Diy_fp minus = multiply(value.minus, c);
+        const Diy_fp plus = multiply(value.plus, c);
+
+        decimal_exponent = -cached.k;
+        return generate_digits(digits, length, decimal_exponent, minus, w, plus);
+    }
+
+    template<typename T> T read_back(const char* text);
+    template<> double read_back<double>(const char* text) { return strtod(text, nullptr); }
+    template<> float read_back<float>(const char* text) { return strtof(text, nullptr); }
+
+    //digits * 10^decimal_exponent reads back as value
+    template<typename T>
+    bool reads_back(T value, const char* digits, int length, int decimal_exponent)
+    {
+        char text[Number_formatter::MAX_LENGTH];
+        snprintf(text, sizeof(text), "%.*se%d", length, digits, decimal_exponent);
+        return read_back<T>(text) == value;
+    }
+
+    /*
+     *  Exact fallback for the values Grisu3 rejects, from the length Grisu3 needed up. At every length the
+     *  correctly rounded digits are closest to the value, so if any digits of that length read back they
+     *  do, except at powers of two: there the interval reaches further up than down and the next digits
+     *  up may read back when the closest, below the value, don't.
+     */
+    template<typename T>
+    int shortest_by_search(T value, int first_length, char* digits, int& decimal_exponent)
+    {
+        int length = std::max(first_length, 1);
+
+        for (;; ++length)
+        {
+            char text[Number_formatter::MAX_LENGTH];
+            snprintf(text, sizeof(text), "%.*e", length - 1, static_cast<double>(value));
+
+            //d.ddde[+-]x
+            digits[0] = text[0];
+            memcpy(digits + 1, text + 2, length - 1);
+            decimal_exponent = atoi(strchr(text, 'e') + 1) - (length - 1);
+
+            if (length >= MAX_PRECISION or reads_back(value, digits, length, decimal_exponent))
+                return length;
+
+            if (read_back<T>(text) > value)
+                continue;
+
+            int last = length - 1;
+            while (last >= 0 and digits[last] == '9')
+                digits[last--] = '0';
+
+            if (last < 0)
+            {
+                digits[0] = '1';
+                ++decimal_exponent;
+            }
+            else
+                ++digits[last];
+
+            if (reads_back(value, digits, length, decimal_exponent))
+                return length;
+        }
+    }
+
+    template<typename T, typename Bits>
+    size_t format_shortest(T value, char* output)
+    {
+        if (not std::isfinite(value))
+            return format_with_printf(value, MAX_PRECISION, output);
+
+        size_t length = 0;
+
+        if (std::signbit(value))
+            output[length++] = '-';
+
+        if (value == 0)
+        {
+            output[length++] = '0';
+            return length;
+        }
+
+        char significand[MAX_PRECISION + 1];
+        int decimal_exponent;
+        int significant;
+
+        if (not grisu3(boundaries<T, Bits>(std::fabs(value)), significand, significant, decimal_exponent))
+            significant = shortest_by_search<T>(std::fabs(value), significant, significand, decimal_exponent);
+
+        while (significant > 1 and significand[significant - 1] == '0')
+        {
+            --significant;
+            ++decimal_exponent;
+        }
+
+        //Laid out like %.17g, so plain numbers stay plain
+        return length + write_significand(significand, significant, decimal_exponent + significant - 1, MAX_PRECISION, output + length);
+    }
+}
+
+size_t Number_formatter::format_general(double value, int precision, char* output)
+{
+    if (precision < 1)
+        precision = 1;
+
+    if (precision > MAX_PRECISION)
+        precision = MAX_PRECISION;
+
+    if (not HAS_EXTENDED_PRECISION or precision > MAX_FAST_PRECISION or not std::isfinite(value))
+        return format_with_printf(value, precision, output);
+
+    size_t length = 0;
+
+    if (std::signbit(value))
+        output[length++] = '-';
+
+    if (value == 0)
+    {
+        output[length++] = '0';
+        return length;
+    }
+
+    const long double magnitude = std::fabs(static_cast<long double>(value));
+
+    //log10 may be one off near powers of ten, the range checks below correct that
+    int exponent = static_cast<int>(std::floor(std::log10(std::fabs(value))));
+    long double scaled;
+
+    if (not scale(magnitude, exponent, precision, scaled))
+        return format_with_printf(value, precision, output);
+
+    if (scaled >= integer_powers_of_ten[precision])
+    {
+        ++exponent;
+        if (not scale(magnitude, exponent, precision, scaled))
+            return format_with_printf(value, precision, output);
+    }
+    else if (scaled < integer_powers_of_ten[precision - 1])
+    {
+        --exponent;
+        if (not scale(magnitude, exponent, precision, scaled))
+            return format_with_printf(value, precision, output);
+    }
+
+    const long double integer_part = std::floor(scaled);
+    const long double fraction = scaled - integer_part;
+
+    if (std::fabs(fraction - 0.5L) < TIE_MARGIN)
+        return format_with_printf(value, precision, output);
+
+    uint64_t digits = static_cast<uint64_t>(integer_part) + (fraction > 0.5L ? 1 : 0);
+
+    if (digits == integer_powers_of_ten[precision])
+    {
+        digits /= 10;
+        ++exponent;
+    }
+
+    char significand[MAX_FAST_PRECISION];
+
+    for (int i = precision - 1; i >= 0; --i)
+    {
+        significand[i] = '0' + digits % 10;
+        digits /= 10;
+    }
+
+    //%g drops trailing zeros
+    int significant = precision;
+    while (significant > 1 and significand[significant - 1] == '0')
+        --significant;
+
+    return length + write_significand(significand, significant, exponent, precision, output + length);
+}
+
+size_t Number_formatter::format_shortest(double value, char* output)
+{
+    return ::format_shortest<double, uint64_t>(value, output);
+}
+
+size_t Number_formatter::format_shortest_float(double value, char* output)
+{
+    return ::format_shortest<float, uint32_t>(static_cast<float>(value), output);
+}
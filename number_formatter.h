@@ -0,0 +1,66 @@
+#ifndef NUMBER_FORMATTER_H
+#define NUMBER_FORMATTER_H
+
+#include <string>
+#include <cstddef>
+
+/*
+ *  Number to text conversion for the writers, the counterpart of number_parser.h.
+ *
+ *  format_general prints like printf's %.[precision]g (and thus like an ostream with setprecision),
+ *  without locale lookups or stream state. Digits are generated by scaling in extended precision;
+ *  values that end up too close to a rounding tie to decide safely are handed to snprintf,
+ *  so the output always matches printf. Precision is capped at 17 digits, all a double can hold.
+ *
+ *  format_shortest prints the fewest digits that read back to the same double (Grisu3, with an exact search
+ *  for the values it can't decide), format_shortest_float the fewest that read back to the same float after
+ *  rounding the value to float.
+ */
+
+namespace Number_formatter {
+
+    //Enough for any double in %g notation at up to 17 significant digits
+    constexpr size_t MAX_LENGTH = 32;
+
+    //Writes value to output (MAX_LENGTH bytes), returns the number of characters written.
+    size_t format_general(double value, int precision, char* output);
+
+    size_t format_shortest(double value, char* output);
+
+    size_t format_shortest_float(double value, char* output);
+
+    inline void append_general(std::string& buffer, double value, int precision)
+    {
+        char formatted[MAX_LENGTH];
+        buffer.append(formatted, format_general(value, precision, formatted));
+    }
+
+    inline void append_shortest(std::string& buffer, double value)
+    {
+        char formatted[MAX_LENGTH];
+        buffer.append(formatted, format_shortest(value, formatted));
+    }
+
+    inline void append_shortest_float(std::string& buffer, double value)
+    {
+        char formatted[MAX_LENGTH];
+        buffer.append(formatted, format_shortest_float(value, formatted));
+    }
+
+    //Decimal representation, as ostream would print it.
+    inline void append_unsigned(std::string& buffer, size_t value)
+    {
+        char digits[20];
+        size_t length = 0;
+
+        do {
+            digits[length++] = '0' + value % 10;
+            value /= 10;
+        } while (value != 0);
+
+        while (length > 0)
+            buffer.push_back(digits[--length]);
+    }
+}
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef NUMBER_PARSER_H
+#define NUMBER_PARSER_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+/*
+ *  Allocation-free text to number conversion for the readers.
+ *
+ *  parse_double handles the decimal and scientific notation our writers produce without touching the heap.
+ *  Numbers with at most 19 significant digits and a decimal exponent within [-22, 22] are converted exactly
+ *  with a single multiplication or division (Clinger's fast path). Anything else (long mantissas, huge exponents,
+ *  inf, nan) falls back to strtod on a copy of the token, so results always equal strtod's.
+ */
+
+namespace Number_parser {
+
+    constexpr int MAX_FAST_EXPONENT = 22;
+    constexpr uint64_t MAX_FAST_MANTISSA = uint64_t(1) << 53;
+    constexpr size_t MAX_TOKEN_LENGTH = 64;
+
+    constexpr double powers_of_ten[MAX_FAST_EXPONENT + 1] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    inline bool is_digit(const char c) noexcept
+    {
+        return static_cast<unsigned char>(c - '0') < 10;
+    }
+
+    inline bool is_delimiter(const char c) noexcept
+    {
+        return c == '\t' or c == ' ' or c == '\n' or c == '\r';
+    }
+
+    //Slow, exact path. Copies the token so strtod can never run past the end of a mapped range.
+    inline const char* parse_double_fallback(const char* first, const char* last, double& value)
+    {
+        const char* token_end = first;
+        while (token_end != last and not is_delimiter(*token_end))
+            ++token_end;
+
+        size_t length = token_end - first;
+        char* end = nullptr;
+
+        if (length < MAX_TOKEN_LENGTH)
+        {
+            char token[MAX_TOKEN_LENGTH];
+            memcpy(token, first, length);
+            token[length] = '\0';
+            value = strtod(token, &end);
+            return first + (end - token);
+        }
+
+        std::string token(first, length);
+        value = strtod(token.c_str(), &end);
+        return first + (end - token.c_str());
+    }
+
+    //Parses a double starting at first. Returns a pointer past the last character consumed, or first on failure.
+    inline const char* parse_double(const char* first, const char* last, double& value)
+    {
+        const char* position = first;
+        bool negative = false;
+
+        if (position != last and (*position == '-' or *position == '+'))
+        {
+            negative = *position == '-';
+            ++position;
+        }
+
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        int significant_digits = 0;
+        bool has_digits = false;
+        bool truncated = false;
+
+        for (; position != last and is_digit(*position); ++position)
+        {
+            has_digits = true;
+            if (significant_digits < 19)
+            {
+                mantissa = mantissa * 10 + (*position - '0');
+                if (mantissa != 0)
+                    ++significant_digits;
+            }
+            else
+            {
+                truncated = true;
+                ++exponent;
+            }
+        }
+
+        if (position != last and *position == '.')
+        {
+            ++position;
+            for (; position != last and is_digit(*position); ++position)
+            {
+                has_digits = true;
+                if (significant_digits < 19)
+                {
+                    mantissa = mantissa * 10 + (*position - '0');
+                    if (mantissa != 0)
+                        ++significant_digits;
+                    --exponent;
+                }
+                else
+                {
+                    truncated = true;
+                }
+            }
+        }
+
+        if (not has_digits)
+            return parse_double_fallback(first, last, value);
+
+        if (position != last and (*position == 'e' or *position == 'E'))
+        {
+            const char* exponent_position = position + 1;
+            bool negative_exponent = false;
+
+            if (exponent_position != last and (*exponent_position == '-' or *exponent_position == '+'))
+            {
+                negative_exponent = *exponent_position == '-';
+                ++exponent_position;
+            }
+
+            //A dangling 'e' is not part of the number, just like strtod treats it.
+            if (exponent_position != last and is_digit(*exponent_position))
+            {
+                int explicit_exponent = 0;
+                for (; exponent_position != last and is_digit(*exponent_position); ++exponent_position)
+                    if (explicit_exponent < 100000)
+                        explicit_exponent = explicit_exponent * 10 + (*exponent_position - '0');
+
+                exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+                position = exponent_position;
+            }
+        }
+
+        if (truncated or mantissa > MAX_FAST_MANTISSA
+            or exponent < -MAX_FAST_EXPONENT or exponent > MAX_FAST_EXPONENT)
+                return parse_double_fallback(first, last, value);
+
+        double result = static_cast<double>(mantissa);
+
+        if (exponent < 0)
+            result /= powers_of_ten[-exponent];
+        else
+            result *= powers_of_ten[exponent];
+
+        value = negative ? -result : result;
+
+        return position;
+    }
+
+    //Skips a single field of a delimited line, leaves position on the delimiter.
+    inline const char* skip_field(const char* first, const char* last, const char delimiter) noexcept
+    {
+        while (first != last and *first != delimiter and *first != '\n')
+            ++first;
+        return first;
+    }
+
+    inline const char* next_line(const char* first, const char* last) noexcept
+    {
+        const char* newline = static_cast<const char*>(memchr(first, '\n', last - first));
+        return newline ? newline + 1 : last;
+    }
+
+    inline size_t count_lines(const char* first, const char* last) noexcept
+    {
+        size_t lines = 0;
+
+        while (first != last)
+        {
+            const char* newline = static_cast<const char*>(memchr(first, '\n', last - first));
+            ++lines;
+            if (not newline)
+                break;
+            first = newline + 1;
+        }
+
+        return lines;
+    }
+}
+
+#endif
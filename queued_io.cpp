@@ -0,0 +1,579 @@
+#include "queued_io.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+    std::atomic<bool> uring_enabled {true};
+
+    int io_uring_setup(unsigned entries, struct io_uring_params* parameters)
+    {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, parameters));
+    }
+
+    int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+    {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+    }
+
+    //Blocking fallback, a request at a time
+    bool transfer_blocking(bool write, int fd, char* data, size_t size, uint64_t offset)
+    {
+        while (size > 0)
+        {
+            const size_t request = std::min(size, Queued_io::REQUEST_SIZE);
+            const ssize_t done = write ? pwrite(fd, data, request, offset) : pread(fd, data, request, offset);
+
+            if (done < 0 and errno == EINTR)
+                continue;
+
+            if (done <= 0)
+            {
+                if (done == 0)
+                    errno = EIO;
+                return false;
+            }
+
+            data += done;
+            size -= done;
+            offset += done;
+        }
+
+        return true;
+    }
+
+    char* allocate_block()
+    {
+        void* block = nullptr;
+
+        if (posix_memalign(&block, Queued_io::ALIGNMENT, Queued_io::REQUEST_SIZE) != 0)
+            throw std::bad_alloc();
+
+        return static_cast<char*>(block);
+    }
+}
+
+//Submission and completion queues shared with the kernel, used by a single thread
+class Queued_io::Ring {
+    public:
+        explicit Ring(unsigned entries);
+        ~Ring();
+
+        Ring(const Ring&) = delete;
+        Ring& operator=(const Ring&) = delete;
+
+        bool valid() const noexcept { return m_fd != -1; }
+
+        //Queues a readv or writev of request at offset, submitted by the next wait(). Never more than the entries
+        //the ring was set up with may be in flight.
+        void queue(bool write, int fd, const struct iovec* request, uint64_t offset, uint64_t tag);
+        //Submits what is queued and waits for a request to finish: its tag, and bytes transferred or -errno.
+        //False when the ring itself fails, then nothing completes anymore.
+        bool wait(uint64_t& tag, int32_t& result);
+
+    private:
+        int m_fd;
+        unsigned m_to_submit;
+
+        void* m_sq_ring;
+        size_t m_sq_ring_size;
+        void* m_cq_ring;
+        size_t m_cq_ring_size;
+        struct io_uring_sqe* m_sqes;
+        size_t m_sqes_size;
+
+        unsigned* m_sq_head;
+        unsigned* m_sq_tail;
+        unsigned m_sq_mask;
+        unsigned* m_sq_array;
+        unsigned* m_cq_head;
+        unsigned* m_cq_tail;
+        unsigned m_cq_mask;
+        struct io_uring_cqe* m_cqes;
+
+        void unmap();
+};
+
+Queued_io::Ring::Ring(unsigned entries)
+    : m_fd{-1}, m_to_submit{0}, m_sq_ring{MAP_FAILED}, m_sq_ring_size{0}, m_cq_ring{MAP_FAILED}, m_cq_ring_size{0}, m_sqes{nullptr}, m_sqes_size{0}
+{
+    if (not uring_enabled)
+        return;
+
+    struct io_uring_params parameters;
+    memset(&parameters, 0, sizeof(parameters));
+
+    m_fd = io_uring_setup(entries, &parameters);
+
+    if (m_fd == -1)
+        return;
+
+    m_sq_ring_size = parameters.sq_off.array + parameters.sq_entries * sizeof(unsigned);
+    m_cq_ring_size = parameters.cq_off.cqes + parameters.cq_entries * sizeof(struct io_uring_cqe);
+
+    //Newer kernels share one mapping between both rings
+    if (parameters.features & IORING_FEAT_SINGLE_MMAP)
+        m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+
+    m_sq_ring = mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+
+    if (m_sq_ring != MAP_FAILED)
+        m_cq_ring = parameters.features & IORING_FEAT_SINGLE_MMAP ? m_sq_ring
+            : mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+
+    m_sqes_size = parameters.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = m_cq_ring == MAP_FAILED ? MAP_FAILED
+        : mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+
+    if (sqes == MAP_FAILED)
+    {
+        unmap();
+        close(m_fd);
+        m_fd = -1;
+        return;
+    }
+
+    m_sqes = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* const sq = static_cast<char*>(m_sq_ring);
+    m_sq_head = reinterpret_cast<unsigned*>(sq + parameters.sq_off.head);
+    m_sq_tail = reinterpret_cast<unsigned*>(sq + parameters.sq_off.tail);
+    m_sq_mask = *reinterpret_cast<unsigned*>(sq + parameters.sq_off.ring_mask);
+    m_sq_array = reinterpret_cast<unsigned*>(sq + parameters.sq_off.array);
+
+    char* const cq = static_cast<char*>(m_cq_ring);
+    m_cq_head = reinterpret_cast<unsigned*>(cq + parameters.cq_off.head);
+    m_cq_tail = reinterpret_cast<unsigned*>(cq + parameters.cq_off.tail);
+    m_cq_mask = *reinterpret_cast<unsigned*>(cq + parameters.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<struct io_uring_cqe*>(cq + parameters.cq_off.cqes);
+}
+
+Queued_io::Ring::~Ring()
+{
+    if (m_fd == -1)
+        return;
+
+    unmap();
+    close(m_fd);
+}
+
+void Queued_io::Ring::unmap()
+{
+    if (m_sqes)
+        munmap(m_sqes, m_sqes_size);
+
+    if (m_cq_ring != MAP_FAILED and m_cq_ring != m_sq_ring)
+        munmap(m_cq_ring, m_cq_ring_size);
+
+    if (m_sq_ring != MAP_FAILED)
+        munmap(m_sq_ring, m_sq_ring_size);
+}
+
+void Queued_io::Ring::queue(bool write, int fd, const struct iovec* request, uint64_t offset, uint64_t tag)
+{
+    const unsigned tail = *m_sq_tail;
+    const unsigned index = tail & m_sq_mask;
+
+    struct io_uring_sqe& sqe = m_sqes[index];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(request);
+    sqe.len = 1;
+    sqe.off = offset;
+    sqe.user_data = tag;
+
+    m_sq_array[index] = index;
+    //The kernel may only see the new tail after the entry is complete
+    __atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++m_to_submit;
+}
+
+bool Queued_io::Ring::wait(uint64_t& tag, int32_t& result)
+{
+    for (;;)
+    {
+        const unsigned head = *m_cq_head;
+
+        if (head != __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE))
+        {
+            const struct io_uring_cqe& cqe = m_cqes[head & m_cq_mask];
+            tag = cqe.user_data;
+            result = cqe.res;
+            __atomic_store_n(m_cq_head, head + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+        const int submitted = io_uring_enter(m_fd, m_to_submit, 1, IORING_ENTER_GETEVENTS);
+
+        if (submitted < 0)
+        {
+            if (errno == EINTR or errno == EAGAIN or errno == EBUSY)
+                continue;
+
+            result = -errno;
+            return false;
+        }
+
+        m_to_submit -= std::min<unsigned>(submitted, m_to_submit);
+    }
+}
+
+bool Queued_io::uring_available()
+{
+    static const bool available = [] {
+        struct io_uring_params parameters;
+        memset(&parameters, 0, sizeof(parameters));
+
+        const int fd = io_uring_setup(1, &parameters);
+
+        if (fd != -1)
+            close(fd);
+
+        return fd != -1;
+    }();
+
+    return available;
+}
+
+void Queued_io::use_uring(bool enabled)
+{
+    uring_enabled = enabled;
+}
+
+bool Queued_io::read(int fd, char* destination, size_t size, size_t offset, const Progress& progress)
+{
+    Ring ring(QUEUE_DEPTH);
+
+    if (not ring.valid())
+    {
+        if (not progress)
+            return transfer_blocking(false, fd, destination, size, offset);
+
+        for (size_t done = 0; done < size; done += REQUEST_SIZE)
+        {
+            if (not transfer_blocking(false, fd, destination + done, std::min(REQUEST_SIZE, size - done), offset + done))
+                return false;
+
+            progress(std::min(size, done + REQUEST_SIZE));
+        }
+
+        return true;
+    }
+
+    //A request per slot, the tag is the slot
+    struct Request {
+        struct iovec part;
+        uint64_t offset;
+        size_t index;
+    };
+
+    std::vector<Request> requests(QUEUE_DEPTH);
+    size_t next = 0;
+    unsigned in_flight = 0;
+    int error = 0;
+
+    //Requests complete in any order, progress counts those up to the first one still out
+    std::vector<bool> finished((size + REQUEST_SIZE - 1) / REQUEST_SIZE, false);
+    size_t arrived = 0;
+
+    auto issue = [&] (size_t slot) {
+        const size_t size_of_part = std::min(REQUEST_SIZE, size - next);
+
+        requests[slot] = {{destination + next, size_of_part}, offset + next, next / REQUEST_SIZE};
+        ring.queue(false, fd, &requests[slot].part, requests[slot].offset, slot);
+        next += size_of_part;
+        ++in_flight;
+    };
+
+    for (size_t slot = 0; slot < QUEUE_DEPTH and next < size; ++slot)
+        issue(slot);
+
+    while (in_flight > 0)
+    {
+        uint64_t slot;
+        int32_t result;
+
+        if (not ring.wait(slot, result))
+        {
+            errno = -result;
+            return false;
+        }
+
+        --in_flight;
+
+        Request& request = requests[slot];
+
+        if (result == -EINTR or result == -EAGAIN)
+            result = 0;
+        else if (result <= 0)
+        {
+            //Requests still in flight are waited for, they write into destination
+            error = result == 0 ? EIO : -result;
+            continue;
+        }
+
+        if (static_cast<size_t>(result) < request.part.iov_len)
+        {
+            request.part.iov_base = static_cast<char*>(request.part.iov_base) + result;
+            request.part.iov_len -= result;
+            request.offset += result;
+            ring.queue(false, fd, &request.part, request.offset, slot);
+            ++in_flight;
+            continue;
+        }
+
+        if (progress and error == 0)
+        {
+            finished[request.index] = true;
+
+            const size_t before = arrived;
+            while (arrived < finished.size() and finished[arrived])
+                ++arrived;
+
+            if (arrived != before)
+                progress(std::min(size, arrived * REQUEST_SIZE));
+        }
+
+        if (error == 0 and next < size)
+            issue(slot);
+    }
+
+    if (error != 0)
+    {
+        errno = error;
+        return false;
+    }
+
+    return true;
+}
+
+Queued_io::Output_buffer::Output_buffer()
+    : m_fd{-1}, m_offset{0}, m_error{0}, m_current{0}
+{
+}
+
+Queued_io::Output_buffer::~Output_buffer()
+{
+    close();
+
+    for (Buffer& buffer : m_buffers)
+        free(buffer.data);
+}
+
+bool Queued_io::Output_buffer::open(const std::string& filename, bool append)
+{
+    if (m_fd != -1)
+        return false;
+
+    m_fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | (append ? 0 : O_TRUNC), 0666);
+
+    if (m_fd == -1)
+        return false;
+
+    struct stat status;
+    m_offset = append and fstat(m_fd, &status) == 0 ? status.st_size : 0;
+    m_error = 0;
+
+    if (not m_ring)
+        m_ring.reset(new Ring(QUEUE_DEPTH));
+
+    //Without a ring a single buffer is written while the next one fills
+    const size_t buffers = m_ring->valid() ? QUEUE_DEPTH : 1;
+
+    while (m_buffers.size() < buffers)
+        m_buffers.push_back({allocate_block(), {nullptr, 0}, 0, false});
+
+    m_current = 0;
+    setp(m_buffers[0].data, m_buffers[0].data + REQUEST_SIZE);
+
+    return true;
+}
+
+void Queued_io::Output_buffer::queue(Buffer& buffer)
+{
+    m_ring->queue(true, m_fd, &buffer.request, buffer.offset, &buffer - m_buffers.data());
+    buffer.in_flight = true;
+}
+
+void Queued_io::Output_buffer::complete_one()
+{
+    uint64_t index;
+    int32_t result;
+
+    if (not m_ring->wait(index, result))
+    {
+        m_error = -result;
+
+        for (Buffer& buffer : m_buffers)
+            buffer.in_flight = false;
+
+        return;
+    }
+
+    Buffer& buffer = m_buffers[index];
+
+    if (result == -EINTR or result == -EAGAIN)
+        result = 0;
+    else if (result <= 0)
+    {
+        m_error = result == 0 ? EIO : -result;
+        buffer.in_flight = false;
+        return;
+    }
+
+    buffer.request.iov_base = static_cast<char*>(buffer.request.iov_base) + result;
+    buffer.request.iov_len -= result;
+    buffer.offset += result;
+
+    if (buffer.request.iov_len == 0)
+        buffer.in_flight = false;
+    else
+        queue(buffer);
+}
+
+bool Queued_io::Output_buffer::complete_all()
+{
+    while (std::any_of(m_buffers.begin(), m_buffers.end(), [] (const Buffer& buffer) { return buffer.in_flight; }))
+        complete_one();
+
+    return m_error == 0;
+}
+
+bool Queued_io::Output_buffer::submit_current()
+{
+    Buffer& current = m_buffers[m_current];
+    const size_t size = pptr() - pbase();
+
+    if (size > 0 and m_error == 0)
+    {
+        current.request = {current.data, size};
+        current.offset = m_offset;
+        m_offset += size;
+
+        if (m_ring->valid())
+            queue(current);
+        else if (not transfer_blocking(true, m_fd, current.data, size, current.offset))
+            m_error = errno;
+    }
+
+    //Round robin, so the buffer up next is the one queued longest ago
+    m_current = (m_current + 1) % m_buffers.size();
+
+    while (m_buffers[m_current].in_flight)
+        complete_one();
+
+    setp(m_buffers[m_current].data, m_buffers[m_current].data + REQUEST_SIZE);
+
+    return m_error == 0;
+}
+
+Queued_io::Output_buffer::int_type Queued_io::Output_buffer::overflow(int_type character)
+{
+    if (m_fd == -1 or not submit_current())
+        return traits_type::eof();
+
+    if (not traits_type::eq_int_type(character, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(character);
+        pbump(1);
+    }
+
+    return traits_type::not_eof(character);
+}
+
+std::streamsize Queued_io::Output_buffer::xsputn(const char* text, std::streamsize count)
+{
+    std::streamsize written = 0;
+
+    while (written < count)
+    {
+        if (pptr() == epptr() and (m_fd == -1 or not submit_current()))
+            break;
+
+        const std::streamsize part = std::min<std::streamsize>(count - written, epptr() - pptr());
+        memcpy(pptr(), text + written, part);
+        pbump(static_cast<int>(part));
+        written += part;
+    }
+
+    return written;
+}
+
+int Queued_io::Output_buffer::sync()
+{
+    if (m_fd == -1)
+        return 0;
+
+    return submit_current() and complete_all() ? 0 : -1;
+}
+
+bool Queued_io::Output_buffer::close()
+{
+    if (m_fd == -1)
+        return true;
+
+    const bool written = sync() == 0;
+    const bool closed = ::close(m_fd) == 0;
+
+    m_fd = -1;
+    setp(nullptr, nullptr);
+
+    return written and closed;
+}
+
+Queued_io::Output_file::Output_file(const bool& queued_)
+    : std::ostream(nullptr), m_queued(queued_)
+{
+}
+
+Queued_io::Output_file::~Output_file()
+{
+    close();
+}
+
+void Queued_io::Output_file::open(const std::string& filename, std::ios_base::openmode mode)
+{
+    bool opened;
+
+    if (m_queued)
+    {
+        opened = m_output_buffer.open(filename, mode & std::ios_base::app);
+        rdbuf(&m_output_buffer);
+    }
+    else
+    {
+        opened = m_filebuf.open(filename, mode | std::ios_base::out) != nullptr;
+        rdbuf(&m_filebuf);
+    }
+
+    if (not opened)
+        setstate(std::ios_base::failbit);
+}
+
+void Queued_io::Output_file::close()
+{
+    bool closed = true;
+
+    if (rdbuf() == &m_output_buffer)
+        closed = m_output_buffer.close();
+    else if (rdbuf() == &m_filebuf and m_filebuf.is_open())
+        closed = m_filebuf.close() != nullptr;
+
+    if (not closed)
+        setstate(std::ios_base::failbit);
+}
+
+bool Queued_io::Output_file::is_open() const
+{
+    return m_output_buffer.is_open() or m_filebuf.is_open();
+}
@@ -0,0 +1,103 @@
+#ifndef QUEUED_IO_H
+#define QUEUED_IO_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <ostream>
+#include <fstream>
+#include <streambuf>
+#include <cstddef>
+#include <cstdint>
+#include <sys/uio.h>
+
+/*
+ *  File I/O as large requests queued to the kernel, through io_uring where the kernel allows it.
+ *
+ *  Reads and writes are cut in REQUEST_SIZE requests at page aligned addresses and file offsets, with up to
+ *  QUEUE_DEPTH of them in flight, so the latency of a request is paid per queue rather than per call. io_uring is
+ *  set up with raw syscalls from <linux/io_uring.h>, without liburing. Where it can't be, e.g. before Linux 5.1 or
+ *  when seccomp forbids it, the same requests are made one after another with pread and pwrite.
+ */
+
+namespace Queued_io {
+
+    constexpr size_t REQUEST_SIZE = 1 << 20;
+    constexpr unsigned QUEUE_DEPTH = 8;
+    constexpr size_t ALIGNMENT = 4096;
+
+    //The kernel lets us set up io_uring, probed once
+    bool uring_available();
+    //false sends everything through the blocking fallback, e.g. to compare both
+    void use_uring(bool);
+
+    //Called with the number of bytes from the start of a read that are in memory, each time that grows
+    typedef std::function<void(size_t)> Progress;
+
+    //Reads size bytes at offset of fd into destination. False, with errno set, on errors or a short file.
+    bool read(int fd, char* destination, size_t size, size_t offset = 0, const Progress& progress = nullptr);
+
+    class Ring;
+
+    //Stream buffer writing to a file in queued REQUEST_SIZE requests, QUEUE_DEPTH buffers at most
+    class Output_buffer : public std::streambuf {
+        public:
+            Output_buffer();
+            ~Output_buffer();
+
+            Output_buffer(const Output_buffer&) = delete;
+            Output_buffer& operator=(const Output_buffer&) = delete;
+
+            //Truncates the file, or with append writes after what it holds
+            bool open(const std::string& filename, bool append);
+            //Waits for every write and closes the file. False if anything failed.
+            bool close();
+            bool is_open() const noexcept { return m_fd != -1; }
+
+        protected:
+            int_type overflow(int_type character) override;
+            std::streamsize xsputn(const char* text, std::streamsize count) override;
+            int sync() override;
+
+        private:
+            struct Buffer {
+                char* data;
+                struct iovec request;
+                uint64_t offset;
+                bool in_flight;
+            };
+
+            int m_fd;
+            uint64_t m_offset;
+            int m_error;
+            std::unique_ptr<Ring> m_ring;
+            std::vector<Buffer> m_buffers;
+            size_t m_current;
+
+            //Hands the filled part of the current buffer to the kernel and switches to a free one
+            bool submit_current();
+            void queue(Buffer&);
+            //Waits for one write to finish, requeueing it when it was short
+            void complete_one();
+            bool complete_all();
+    };
+
+    //std::ofstream lookalike for the writers, writing through Output_buffer when queued is set at open()
+    class Output_file : public std::ostream {
+        public:
+            explicit Output_file(const bool& queued);
+            ~Output_file();
+
+            void open(const std::string& filename, std::ios_base::openmode mode = std::ios_base::out);
+            void close();
+            bool is_open() const;
+
+        private:
+            const bool& m_queued;
+            std::filebuf m_filebuf;
+            Output_buffer m_output_buffer;
+    };
+}
+
+#endif
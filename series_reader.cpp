@@ -0,0 +1,162 @@
+#include "series_reader.h"
+
+#include <algorithm>
+#include <iostream>
+#include <unistd.h>
+
+constexpr size_t Series_reader::DEFAULT_LOOKAHEAD;
+
+size_t Series_reader::Snapshot::bytes() const noexcept
+{
+    size_t values = 0;
+
+    for (const std::vector<double>& component : components)
+        values += component.size();
+
+    return values * sizeof(double);
+}
+
+Series_reader::Series_reader(const std::string& stem_, const std::string& extension_, size_t first_, size_t last_)
+: m_stem{stem_}, m_extension{extension_}, m_last{last_}, m_next{first_}, m_next_load{first_}, m_reserved{0}, m_estimate{0}, m_started{false}, m_stopping{false}
+{
+}
+
+Series_reader::~Series_reader()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+
+    m_condition.notify_all();
+
+    for (std::thread& loader : m_loaders)
+        loader.join();
+}
+
+std::string Series_reader::filename(const std::string& stem, const std::string& extension, size_t identifier)
+{
+    return stem + "_" + std::to_string(identifier) + "." + extension;
+}
+
+bool Series_reader::may_load() const noexcept
+{
+    if (m_stopping or m_next_load > m_last or m_next_load - m_next >= std::max<size_t>(configuration.lookahead, 1))
+        return false;
+
+    //Nothing ahead yet, or the size of a snapshot is known and another one fits
+    return configuration.memory_budget == 0 or m_next_load == m_next
+        or (m_estimate != 0 and m_reserved + m_estimate <= configuration.memory_budget);
+}
+
+bool Series_reader::next(Snapshot& snapshot)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (m_next > m_last)
+        return false;
+
+    if (not m_started)
+    {
+        m_started = true;
+
+        for (size_t i = 0; i < std::max<size_t>(configuration.loaders, 1); ++i)
+            m_loaders.emplace_back(&Series_reader::work, this);
+    }
+
+    m_condition.wait(lock, [this] { return m_loaded.count(m_next) == 1; });
+
+    Loaded& loaded = m_loaded[m_next];
+    const std::exception_ptr exception = loaded.exception;
+
+    m_reserved -= loaded.snapshot.bytes();
+    std::swap(snapshot, loaded.snapshot);
+    m_free.push_back(std::move(loaded.snapshot));
+    m_loaded.erase(m_next++);
+
+    lock.unlock();
+    m_condition.notify_all();
+
+    if (exception)
+        std::rethrow_exception(exception);
+
+    return true;
+}
+
+void Series_reader::load(Snapshot& snapshot)
+{
+    //Readable_file exits on a missing file, which would take the caller down from this thread
+    if (access(snapshot.filename.c_str(), F_OK) == -1)
+    {
+        std::cerr << "Could not find " << snapshot.filename << " of the series." << std::endl;
+        throw Readable_file::ERROR_FILE_NOT_FOUND;
+    }
+
+    const Readable_filetype filetype = Readable_file::filetype_of(snapshot.filename);
+
+    if (filetype == Readable_filetype::NONE)
+    {
+        std::cerr << "Extension of " << snapshot.filename << " not recognized." << std::endl;
+        throw Readable_file::ERROR_EXTENSION;
+    }
+
+    Reader reader;
+    reader.configuration = configuration.reader;
+
+    IReader& input = reader.open(Readable_file(snapshot.filename, filetype));
+    input.read_through_cache(snapshot.components);
+
+    snapshot.lattice = input.lattice();
+    snapshot.names = input.m_headers;
+}
+
+void Series_reader::work()
+{
+    for (;;)
+    {
+        Loaded loaded;
+        size_t reserved;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stopping or m_next_load > m_last or may_load(); });
+
+            if (not may_load())
+                return;
+
+            if (not m_free.empty())
+            {
+                loaded.snapshot = std::move(m_free.back());
+                m_free.pop_back();
+            }
+
+            loaded.snapshot.identifier = m_next_load++;
+            reserved = m_estimate;
+            m_reserved += reserved;
+        }
+
+        loaded.snapshot.filename = filename(m_stem, m_extension, loaded.snapshot.identifier);
+
+        try
+        {
+            load(loaded.snapshot);
+        }
+        catch (...)
+        {
+            loaded.exception = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            const size_t bytes = loaded.snapshot.bytes();
+
+            m_reserved += bytes;
+            m_reserved -= reserved;
+            m_estimate = std::max(m_estimate, bytes);
+            m_loaded[loaded.snapshot.identifier] = std::move(loaded);
+        }
+
+        m_condition.notify_all();
+    }
+}
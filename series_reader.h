@@ -0,0 +1,96 @@
+#ifndef SERIES_READER_H
+#define SERIES_READER_H
+
+#include "file_reader.h"
+#include "lattice_accessor.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+/*
+ *  Reads a numbered series of snapshots, [stem]_[n].[extension] as Writable_file::increment_identifier names them,
+ *  ahead of the caller.
+ *
+ *  next() hands over snapshots first .. last in order. Meanwhile configuration.loaders background threads read and
+ *  parse the ones after it, at most configuration.lookahead files ahead, so loading the next file overlaps with
+ *  analyzing the current one. With configuration.memory_budget set, a file is only started while the snapshots
+ *  loaded ahead, the new one estimated as large as the largest so far, fit in that many bytes. The first file ahead
+ *  is always loaded, whatever its size.
+ *
+ *  Storage is recycled: next() swaps the loaded snapshot with the caller's and keeps the caller's vectors for a
+ *  later file. Errors reading a file are rethrown by the next() that would have returned it.
+ */
+
+class Series_reader {
+    public:
+        struct Snapshot {
+            size_t identifier = 0;
+            std::string filename;
+            Lattice_accessor lattice;
+            std::vector<std::string> names;
+            std::vector<std::vector<double>> components;
+
+            size_t bytes() const noexcept;
+        };
+
+        struct Configuration {
+            //Files loaded ahead of the one handed over last
+            size_t lookahead = DEFAULT_LOOKAHEAD;
+            //Threads loading files, each parses with reader.threads
+            size_t loaders = 1;
+            //Bytes of components loaded ahead, 0 for no limit but lookahead
+            size_t memory_budget = 0;
+            //Handed to the reader of every file
+            IReader::Configuration reader;
+        } configuration;
+
+        static constexpr size_t DEFAULT_LOOKAHEAD = 2;
+
+        Series_reader(const std::string& stem, const std::string& extension, size_t first, size_t last);
+        ~Series_reader();
+
+        Series_reader(const Series_reader&) = delete;
+        Series_reader& operator=(const Series_reader&) = delete;
+
+        static std::string filename(const std::string& stem, const std::string& extension, size_t identifier);
+
+        //Blocks until the next snapshot is loaded and swaps it into snapshot. False once all have been handed over.
+        //The first call starts the loaders, so configure before.
+        bool next(Snapshot& snapshot);
+
+    private:
+        struct Loaded {
+            Snapshot snapshot;
+            std::exception_ptr exception;
+        };
+
+        const std::string m_stem;
+        const std::string m_extension;
+        const size_t m_last;
+
+        //Next snapshot handed over, next snapshot a loader starts on
+        size_t m_next;
+        size_t m_next_load;
+        std::map<size_t, Loaded> m_loaded;
+        std::vector<Snapshot> m_free;
+        //Bytes loaded ahead, files being loaded counted at m_estimate
+        size_t m_reserved;
+        size_t m_estimate;
+        bool m_started;
+        bool m_stopping;
+
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        std::vector<std::thread> m_loaders;
+
+        bool may_load() const noexcept;
+        void load(Snapshot&);
+        void work();
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include "sidecar.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <sys/stat.h>
+
+namespace {
+    constexpr const char* EXTENSION = ".cache";
+    constexpr const char MAGIC[8] = "NMCACHE";
+    constexpr uint64_t VERSION = 1;
+    constexpr size_t ALIGNMENT = 8;
+    //Hashed at both ends of the source, and the number and size of pages sampled in between
+    constexpr size_t HASHED_END = 1 << 20;
+    constexpr size_t HASHED_PAGES = 64;
+    constexpr size_t HASHED_PAGE = 1 << 12;
+
+    //64 bit multiply-xorshift over 8 byte words, the tail zero padded
+    uint64_t hash_bytes(uint64_t hash, const char* bytes, size_t size) noexcept
+    {
+        constexpr uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ull;
+
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+        {
+            uint64_t word;
+            memcpy(&word, bytes + i, sizeof(word));
+            hash = (hash ^ word) * MULTIPLIER;
+            hash ^= hash >> 29;
+        }
+
+        if (i < size)
+        {
+            uint64_t word = 0;
+            memcpy(&word, bytes + i, size - i);
+            hash = (hash ^ word) * MULTIPLIER;
+            hash ^= hash >> 29;
+        }
+
+        return hash ^ size;
+    }
+
+    bool source_status(const std::string& source, struct stat& status)
+    {
+        return stat(source.c_str(), &status) == 0;
+    }
+
+    size_t padded(size_t size) noexcept
+    {
+        return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+}
+
+std::string Sidecar::filename(const std::string& source)
+{
+    return source + EXTENSION;
+}
+
+uint64_t Sidecar::content_hash(const std::string& source)
+{
+    std::ifstream file(source, std::ios::binary);
+
+    if (not file)
+        return 0;
+
+    file.seekg(0, std::ios::end);
+    const size_t size = static_cast<size_t>(file.tellg());
+
+    //Offset and length of the parts hashed, the whole file when it is small
+    std::vector<std::pair<size_t, size_t>> parts;
+
+    if (size <= 2 * HASHED_END + HASHED_PAGES * HASHED_PAGE)
+        parts.emplace_back(0, size);
+    else
+    {
+        const size_t middle = size - 2 * HASHED_END;
+
+        parts.emplace_back(0, HASHED_END);
+        for (size_t page = 0; page < HASHED_PAGES; ++page)
+            parts.emplace_back(HASHED_END + middle / HASHED_PAGES * page, HASHED_PAGE);
+        parts.emplace_back(size - HASHED_END, HASHED_END);
+    }
+
+    uint64_t hash = size;
+    std::vector<char> buffer;
+
+    for (const std::pair<size_t, size_t>& part : parts)
+    {
+        buffer.resize(part.second);
+
+        file.seekg(part.first);
+        file.read(buffer.data(), part.second);
+
+        if (static_cast<size_t>(file.gcount()) != part.second)
+            return 0;
+
+        hash = hash_bytes(hash, buffer.data(), part.second);
+    }
+
+    return hash;
+}
+
+bool Sidecar::save(const std::string& source, const Lattice_accessor& lattice, const std::vector<std::string>& names, const std::vector<std::vector<double>>& components)
+{
+    struct stat status;
+
+    if (components.empty() or names.size() != components.size() or not source_status(source, status))
+        return false;
+
+    for (const std::vector<double>& component : components)
+        if (component.size() != components.front().size())
+            return false;
+
+    std::string name_bytes;
+    for (const std::string& name : names)
+    {
+        name_bytes += name;
+        name_bytes += '\0';
+    }
+    name_bytes.resize(padded(name_bytes.size()), '\0');
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.source_size = status.st_size;
+    header.source_seconds = status.st_mtim.tv_sec;
+    header.source_nanoseconds = status.st_mtim.tv_nsec;
+    header.source_hash = content_hash(source);
+    header.dimensionality = lattice.dimensionality;
+    header.MX = lattice.MX;
+    header.MY = lattice.MY;
+    header.MZ = lattice.MZ;
+    header.components = components.size();
+    header.values = components.front().size();
+    header.names_size = name_bytes.size();
+
+    const std::string temporary = filename(source) + ".tmp";
+
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(name_bytes.data(), name_bytes.size());
+
+        for (const std::vector<double>& component : components)
+            file.write(reinterpret_cast<const char*>(component.data()), component.size() * sizeof(double));
+
+        if (not file.flush())
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+
+    return std::rename(temporary.c_str(), filename(source).c_str()) == 0;
+}
+
+Sidecar::Mapping::Mapping(const std::string& source)
+    : m_values{0}, m_data{nullptr}
+{
+    struct stat status, sidecar_status;
+
+    if (not source_status(source, status) or stat(filename(source).c_str(), &sidecar_status) != 0
+        or static_cast<size_t>(sidecar_status.st_size) < sizeof(Header))
+            return;
+
+    std::unique_ptr<Mapped_file> file;
+
+    try
+    {
+        file.reset(new Mapped_file(filename(source)));
+    }
+    catch (Mapped_file::error)
+    {
+        return;
+    }
+
+    Header header;
+    memcpy(&header, file->begin(), sizeof(header));
+
+    //Cheap checks first, the hash reads from the source
+    if (memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0 or header.version != VERSION
+        or header.source_size != static_cast<uint64_t>(status.st_size)
+        or header.source_seconds != status.st_mtim.tv_sec or header.source_nanoseconds != status.st_mtim.tv_nsec
+        or header.dimensionality < 1 or header.dimensionality > 3
+        or sizeof(Header) + header.names_size + header.components * header.values * sizeof(double) != file->size()
+        or header.source_hash != content_hash(source))
+            return;
+
+    const char* name = file->begin() + sizeof(Header);
+    const char* const names_end = name + header.names_size;
+
+    std::vector<std::string> names;
+
+    while (names.size() < header.components and name != names_end)
+    {
+        const char* const name_end = std::find(name, names_end, '\0');
+
+        if (name_end == names_end)
+            return;
+
+        names.emplace_back(name, name_end);
+        name = name_end + 1;
+    }
+
+    if (names.size() != header.components)
+        return;
+
+    m_lattice.dimensionality = static_cast<Dimensionality>(header.dimensionality);
+    m_lattice.MX = header.MX;
+    m_lattice.MY = header.MY;
+    m_lattice.MZ = header.MZ;
+    m_lattice.set_jumps();
+
+    m_names.swap(names);
+    m_values = header.values;
+    //Sections are 8 byte aligned and mappings page aligned, so the doubles can be used where they are
+    m_data = reinterpret_cast<const double*>(names_end);
+    m_file.swap(file);
+}
+
+bool Sidecar::load(const std::string& source, Lattice_accessor& lattice, std::vector<std::string>& names, std::vector<std::vector<double>>& components)
+{
+    Mapping mapping(source);
+
+    if (not mapping.valid())
+        return false;
+
+    components.resize(mapping.names().size());
+
+    for (size_t i = 0; i < components.size(); ++i)
+        components[i].assign(mapping.component(i), mapping.component(i) + mapping.values());
+
+    lattice = mapping.lattice();
+    names = mapping.names();
+
+    return true;
+}
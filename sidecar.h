@@ -0,0 +1,76 @@
+#ifndef SIDECAR_H
+#define SIDECAR_H
+
+#include "lattice_accessor.h"
+#include "mapped_file.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+/*
+ *  Binary copy of a parsed input file, stored next to it as [file].cache, so later reads map it instead of parsing.
+ *
+ *  Native byte order, every section starts at a multiple of 8 bytes:
+ *      header      Sidecar::Header
+ *      names       component names, each followed by '\0', padded with '\0'
+ *      data        the components one after another, doubles in namics layout with bounds
+ *
+ *  A sidecar belongs to the source with the size, mtime and content hash in its header. The hash covers the
+ *  first and last MiB and pages spread over the rest, so checking it reads a few MiB whatever the file size.
+ *  Anything that doesn't match, including a sidecar of another version or byte order, is ignored.
+ */
+
+namespace Sidecar {
+
+    struct Header {
+        char magic[8];
+        uint64_t version;
+        uint64_t source_size;
+        int64_t source_seconds;
+        int64_t source_nanoseconds;
+        uint64_t source_hash;
+        uint64_t dimensionality;
+        uint64_t MX, MY, MZ;
+        uint64_t components;
+        //Values per component
+        uint64_t values;
+        //Bytes of the names section, padding included
+        uint64_t names_size;
+    };
+
+    std::string filename(const std::string& source);
+
+    //Sampled hash of the file's contents, 0 if it can't be read
+    uint64_t content_hash(const std::string& source);
+
+    //Written to [file].cache.tmp and renamed, so nobody maps a sidecar that is half written. False on failure.
+    bool save(const std::string& source, const Lattice_accessor& lattice, const std::vector<std::string>& names, const std::vector<std::vector<double>>& components);
+
+    //The sidecar of source mapped read-only, components used in place without copying
+    class Mapping {
+        public:
+            //valid() is false when there is no sidecar that matches source
+            explicit Mapping(const std::string& source);
+
+            bool valid() const noexcept { return m_file != nullptr; }
+            const Lattice_accessor& lattice() const noexcept { return m_lattice; }
+            const std::vector<std::string>& names() const noexcept { return m_names; }
+            size_t values() const noexcept { return m_values; }
+            const double* component(size_t position) const noexcept { return m_data + position * m_values; }
+
+        private:
+            std::unique_ptr<Mapped_file> m_file;
+            Lattice_accessor m_lattice;
+            std::vector<std::string> m_names;
+            size_t m_values;
+            const double* m_data;
+    };
+
+    //Copies the sidecar of source into components, reusing their storage. False, leaving everything as it was,
+    //when there is no sidecar that matches source.
+    bool load(const std::string& source, Lattice_accessor& lattice, std::vector<std::string>& names, std::vector<std::vector<double>>& components);
+}
+
+#endif
@@ -0,0 +1,157 @@
+#include "file_reader.h"
+#include "file_writer.h"
+#include "lattice_accessor.h"
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/filesystem.hpp>
+
+using namespace boost;
+using namespace boost::program_options;
+
+#include <iostream>
+#include <fstream>
+#include <exception>
+#include <vector>
+#include <map>
+#include <memory>
+
+using namespace std;
+
+//"first:last" or a single plane "first", inclusive, into [begin, end)
+void parse_span(const string& option, const string& span, size_t& begin, size_t& end)
+{
+    const size_t colon = span.find(':');
+
+    try {
+        begin = stoul(span.substr(0, colon));
+        end = (colon == string::npos ? begin : stoul(span.substr(colon + 1))) + 1;
+    } catch (std::exception&) {
+        cerr << "Could not read " << option << " range " << span << ", expected first:last or a single coordinate." << endl;
+        exit(0);
+    }
+}
+
+int main(int argc , char **argv)
+{
+    options_description desc("\nExtract a box or a slice from a .pro, .vtk or .nlc file, reading only the part needed.\nCoordinates are lattice coordinates: 1 .. M inside, 0 and M+1 are bounds.\nAllowed arguments");
+
+    desc.add_options()
+        ("help,h", "Print this help text.")
+        ("input-file,i", value< string >(), "Specifies input file, pro, vtk or nlc format.")
+        ("x-range,x", value< string >(), "[first:last] or [int] X coordinates to keep, inclusive. A single coordinate gives a slice. Defaults to 1:MX.")
+        ("y-range,y", value< string >(), "[first:last] or [int] Y coordinates to keep, as above. Defaults to 1:MY.")
+        ("z-range,z", value< string >(), "[first:last] or [int] Z coordinates to keep, as above. Defaults to 1:MZ.")
+        ("components,c", value< vector<string> >()->multitoken(), "[name] [name] ... Components to extract, all of them by default.")
+        ("threads,j", value< size_t >()->default_value(1), "[int] Threads parsing ASCII files.")
+        ("out-type,o", value< string >()->default_value("vtk"), "Specifies output file type (vtk_structured_grid, vtk_structured_points, vtk_structured_grid_binary, vtk_structured_points_binary, vtk_binary, vti, pro, or nlc).")
+        ("number-format,f", value< string >()->default_value("fixed"), "Number format of text output (fixed, shortest or float).")
+        ("queued-io,q", "Read and write with large queued requests, io_uring where the kernel allows it, instead of mapping the input.")
+        ("block-index,b", ".vtk only: keep where the components start in [file].idx, so later slices of the unchanged file skip the scan for them.");
+
+    positional_options_description p;
+    p.add("input-file", -1);
+
+    variables_map vm;
+    try
+    {
+        store( command_line_parser( argc, argv).options(desc).positional(p).run(), vm );
+        notify(vm);
+
+    } catch (std::exception &e)
+    {
+        cerr << endl << e.what() << endl;
+        cerr << desc << endl;
+    }
+
+    if (vm.count("help")) {
+        cerr << desc << endl;
+        exit(0);
+    }
+
+    if (!vm.count("input-file")) {
+        cerr << "No input file specified." << endl;
+        exit(0);
+    }
+
+    if (Profile_writer::output_options.count(vm["out-type"].as< string >()) == 0) {
+        cerr << "Output type not recognized, please refer to help file" << endl;
+        exit(0);
+    }
+
+    if (Profile_writer::number_formats.count(vm["number-format"].as< string >()) == 0) {
+        cerr << "Unknown number format: " << vm["number-format"].as< string >() << endl;
+        exit(0);
+    }
+
+    filesystem::path filename = vm["input-file"].as< string >();
+    const Readable_filetype in_filetype = Readable_file::filetype_of(filename.string());
+
+    if (in_filetype == Readable_filetype::NONE) {
+        cerr << "Input type of " << filename.string() << " not recognized, expected .pro, .vtk or .nlc." << endl;
+        exit(0);
+    }
+
+    Readable_file in_file(filename.string(), in_filetype);
+
+    Reader in_reader;
+    in_reader.configuration.read_mode = vm.count("queued-io") ? IReader::Read_mode::QUEUED : IReader::Read_mode::MEMORY_MAPPED;
+    in_reader.configuration.threads = vm["threads"].as< size_t >();
+    in_reader.configuration.persist_block_index = vm.count("block-index");
+
+    IReader& input = in_reader.open(in_file);
+
+    //Geometry of the file, to default to its interior
+    input.component_names();
+    const Lattice_accessor& file_lattice = input.lattice();
+
+    Lattice_accessor::Range box = {1, file_lattice.MX + 1, 1, file_lattice.MY + 1, 1, file_lattice.MZ + 1};
+
+    if (vm.count("x-range"))
+        parse_span("x", vm["x-range"].as< string >(), box.x_begin, box.x_end);
+    if (vm.count("y-range"))
+        parse_span("y", vm["y-range"].as< string >(), box.y_begin, box.y_end);
+    if (vm.count("z-range"))
+        parse_span("z", vm["z-range"].as< string >(), box.z_begin, box.z_end);
+
+    Lattice_accessor lattice;
+    vector<vector<double>> slice;
+
+    if (vm.count("components"))
+        input.read_subvolume(box, vm["components"].as< vector<string> >(), lattice, slice);
+    else
+        input.read_subvolume(box, lattice, slice);
+
+    cout << "Extracted " << slice.size() << " components of " << lattice.MX;
+    if (lattice.dimensionality > 1)
+        cout << " x " << lattice.MY;
+    if (lattice.dimensionality > 2)
+        cout << " x " << lattice.MZ;
+    cout << " voxels." << endl;
+
+    /***** WRITE SLICE *****/
+    auto out_filetype = Profile_writer::output_options[ vm["out-type"].as< string >() ];
+
+    //The writers expect a value for every index of the lattice, the .pro reader stores fewer in 1D and 2D
+    for (vector<double>& component : slice)
+        component.resize(lattice.system_size, 0.0);
+
+    Writable_file out_file(filename.stem().string() + "_slice", out_filetype);
+    auto profile_writer = Profile_writer::Factory::Create(out_filetype, &lattice, out_file);
+
+    profile_writer->configuration.number_format = Profile_writer::number_formats[vm["number-format"].as< string >()];
+    profile_writer->configuration.queued_io = vm.count("queued-io");
+
+    std::map<string, std::shared_ptr<IOutput_ptr>> profiles;
+    vector<string> headers = input.m_headers;
+
+    for (size_t i = 0 ; i < slice.size() ; ++i)
+        profiles[headers[i]] = std::make_shared<Output_ptr<double>>(slice[i].data());
+
+    profile_writer->bind_data(profiles);
+
+    profile_writer->prepare_for_data();
+
+    profile_writer->write();
+}
@@ -0,0 +1,126 @@
+#include "thread_pool.h"
+
+#include <atomic>
+#include <exception>
+
+Thread_pool::Thread_pool(size_t threads)
+    : m_stopping{false}
+{
+    //The thread calling parallel_for counts as one of the threads.
+    for (size_t i = 1; i < threads; ++i)
+        m_workers.emplace_back(&Thread_pool::work, this);
+}
+
+Thread_pool::~Thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+
+    m_condition.notify_all();
+
+    for (std::thread& worker : m_workers)
+        worker.join();
+}
+
+size_t Thread_pool::default_thread_count() noexcept
+{
+    size_t threads = std::thread::hardware_concurrency();
+    return threads > 0 ? threads : 1;
+}
+
+size_t Thread_pool::size() const noexcept
+{
+    return m_workers.size() + 1;
+}
+
+void Thread_pool::work()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stopping or not m_tasks.empty(); });
+
+            if (m_stopping and m_tasks.empty())
+                return;
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop();
+        }
+
+        task();
+    }
+}
+
+void Thread_pool::parallel_for(size_t count, const std::function<void(size_t)>& function)
+{
+    if (count == 0)
+        return;
+
+    if (m_workers.empty() or count == 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            function(i);
+        return;
+    }
+
+    //Shared with the helpers, which may only get to run after the caller has finished everything.
+    struct State {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        size_t count;
+        const std::function<void(size_t)>* function;
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::exception_ptr exception;
+    };
+
+    auto state = std::make_shared<State>();
+    state->count = count;
+    state->function = &function;
+
+    auto run = [state] () {
+        size_t i;
+        while ((i = state->next.fetch_add(1)) < state->count)
+        {
+            try
+            {
+                (*state->function)(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (not state->exception)
+                    state->exception = std::current_exception();
+            }
+
+            if (state->done.fetch_add(1) + 1 == state->count)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(m_workers.size(), count - 1);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < helpers; ++i)
+            m_tasks.emplace(run);
+    }
+
+    m_condition.notify_all();
+
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state] { return state->done.load() == state->count; });
+
+    if (state->exception)
+        std::rethrow_exception(state->exception);
+}
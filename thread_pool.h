@@ -0,0 +1,64 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+/*
+ *  Fixed size pool of worker threads.
+ *
+ *  enqueue() hands a single task to the pool and returns its future.
+ *  parallel_for() spreads function(0) .. function(count-1) over the pool. The calling thread
+ *  works along and returns once every index has been handled, so it is safe to call from within a task.
+ */
+
+class Thread_pool {
+    public:
+        explicit Thread_pool(size_t threads = default_thread_count());
+        ~Thread_pool();
+
+        Thread_pool(const Thread_pool&) = delete;
+        Thread_pool& operator=(const Thread_pool&) = delete;
+
+        template<typename Function>
+        std::future<typename std::result_of<Function()>::type> enqueue(Function&& function)
+        {
+            typedef typename std::result_of<Function()>::type Result;
+
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+            std::future<Result> result = task->get_future();
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_tasks.emplace([task] () { (*task)(); });
+            }
+
+            m_condition.notify_one();
+            return result;
+        }
+
+        //Rethrows the first exception thrown by function, after all indices have finished.
+        void parallel_for(size_t count, const std::function<void(size_t)>& function);
+
+        //Number of threads that work on a parallel_for, including the caller.
+        size_t size() const noexcept;
+
+        static size_t default_thread_count() noexcept;
+
+    private:
+        std::vector<std::thread> m_workers;
+        std::queue<std::function<void()>> m_tasks;
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        bool m_stopping;
+
+        void work();
+};
+
+#endif